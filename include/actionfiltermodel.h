@@ -0,0 +1,42 @@
+#ifndef ACTIONFILTERMODEL_H
+#define ACTIONFILTERMODEL_H
+
+#include <QSortFilterProxyModel>
+#include <QQmlEngine>
+#include <QTimer>
+
+class ActionFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_PROPERTY(QString filterText READ filterText WRITE setFilterText NOTIFY filterTextChanged)
+
+public:
+    explicit ActionFilterModel(QObject *parent = nullptr);
+
+    QString filterText() const { return m_filterText; }
+    void setFilterText(const QString &text);
+
+    Q_INVOKABLE int sourceRow(int proxyRow) const;
+
+signals:
+    void filterTextChanged();
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    void applyFilter();
+    void watchSourceModel();
+
+    QString m_filterText;
+    QString m_appliedText;
+    QTimer m_debounceTimer;
+
+    // Result of the last filter pass per source row. When the text only
+    // narrows the search, rows it rejected are not matched again.
+    mutable QList<bool> m_accepted;
+    bool m_narrowing = false;
+};
+
+#endif // ACTIONFILTERMODEL_H
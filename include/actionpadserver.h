@@ -4,6 +4,8 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QProcess>
 #include <QAbstractListModel>
 #include <QJsonObject>
@@ -14,6 +16,14 @@
 #include <QSystemTrayIcon>
 #include <QAction>
 #include <QMenu>
+#include <QSet>
+#include <QPointer>
+#include <QDateTime>
+#include <functional>
+#include "inputinjector.h"
+#include "relaymanager.h"
+#include "trafficrecorder.h"
+#include "workerpool.h"
 
 struct Action {
     QString name;
@@ -21,9 +31,12 @@ struct Action {
     QString arguments;
     QString icon;
     int id;
-    int type = 0;           // 0=command, 1=media, 2=shortcut
+    int type = 0;           // 0=command, 1=media, 2=shortcut, 3=relay
     int mediaKey = 0;       // Media key index
     QString shortcut;       // Shortcut string
+    QString relayTargets;   // Relay peers, "host:port" separated by commas
+    int relayActionId = 0;  // Action id on the peers, 0 to reuse this id
+    bool persistent = false; // Command runs in a long-lived worker process
 };
 
 class ActionModel : public QAbstractListModel
@@ -40,18 +53,32 @@ public:
         IconRole,
         TypeRole,
         MediaKeyRole,
-        ShortcutRole
+        ShortcutRole,
+        RelayTargetsRole,
+        RelayActionIdRole,
+        PersistentRole
     };
 
     explicit ActionModel(QObject *parent = nullptr);
     Q_INVOKABLE void addAction(const QString &name, const QString &command,
                                const QString &arguments, const QString &icon,
-                               int type = 0, int mediaKey = 0, const QString &shortcut = "");
+                               int type = 0, int mediaKey = 0, const QString &shortcut = "",
+                               const QString &relayTargets = "", int relayActionId = 0,
+                               bool persistent = false);
     Q_INVOKABLE void updateAction(int index, const QString &name, const QString &command,
                                   const QString &arguments, const QString &icon,
-                                  int type = 0, int mediaKey = 0, const QString &shortcut = "");
+                                  int type = 0, int mediaKey = 0, const QString &shortcut = "",
+                                  const QString &relayTargets = "", int relayActionId = 0,
+                                  bool persistent = false);
     Q_INVOKABLE void removeAction(int index);
 
+    // Batch mutations: changes made between beginBatch() and the matching
+    // commitBatch() are persisted and broadcast once, on the outermost commit
+    Q_INVOKABLE void beginBatch();
+    Q_INVOKABLE void commitBatch();
+    Q_INVOKABLE int importFromFile(const QString &filePath, bool replace = false);
+    Q_INVOKABLE bool exportToFile(const QString &filePath) const;
+
     // QAbstractListModel interface
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
@@ -59,6 +86,11 @@ public:
 
     const QList<Action>& getActions() const { return m_actions; }
     void loadActions();
+    int indexOfAction(int actionId) const;
+
+    int importActions(const QJsonArray &actions, bool replace = false);
+    QJsonArray exportActions() const;
+    int applyOperations(const QJsonArray &operations);
 
 signals:
     void actionsChanged();
@@ -66,9 +98,14 @@ signals:
 private:
     void saveToSettings();
     void loadFromSettings();
+    void commitChanges();
+    static Action actionFromJson(const QJsonObject &obj);
+    static QJsonObject actionToJson(const Action &action);
 
     QList<Action> m_actions;
     int m_nextId = 1;
+    int m_batchDepth = 0;
+    bool m_batchDirty = false;
 };
 
 class ActionPadServer : public QObject
@@ -80,9 +117,13 @@ class ActionPadServer : public QObject
     Q_PROPERTY(QString serverAddress READ serverAddress NOTIFY serverAddressChanged)
     Q_PROPERTY(int serverPort READ serverPort NOTIFY serverPortChanged)
     Q_PROPERTY(int clientCount READ clientCount NOTIFY clientCountChanged)
+    Q_PROPERTY(bool isLocalServerRunning READ isLocalServerRunning NOTIFY localServerChanged)
+    Q_PROPERTY(QString localServerName READ localServerName NOTIFY localServerChanged)
     Q_PROPERTY(ActionModel* actionModel READ actionModel CONSTANT)
     Q_PROPERTY(bool windowVisible READ windowVisible WRITE setWindowVisible NOTIFY windowVisibleChanged)
     Q_PROPERTY(bool isRunAtStartup READ isRunAtStartup NOTIFY isRunAtStartupChanged FINAL)
+    Q_PROPERTY(bool isRecording READ isRecording NOTIFY isRecordingChanged)
+    Q_PROPERTY(bool tracingEnabled READ tracingEnabled WRITE setTracingEnabled NOTIFY tracingEnabledChanged)
 
 public:
     static ActionPadServer* create(QQmlEngine *qmlEngine, QJSEngine *jsEngine);
@@ -91,23 +132,39 @@ public:
     bool isRunning() const { return m_server->isListening(); }
     QString serverAddress() const { return m_serverAddress; }
     int serverPort() const { return m_serverPort; }
-    int clientCount() const { return m_clients.size(); }
+    int clientCount() const { return m_clients.size() - m_relayClients.size(); }
+    bool isLocalServerRunning() const { return m_localServer->isListening(); }
+    QString localServerName() const { return m_localServer->fullServerName(); }
     ActionModel* actionModel() { return &m_actionModel; }
     bool windowVisible() const { return m_windowVisible; }
     void setWindowVisible(bool visible);
     bool isRunAtStartup() const { return m_isRunAtStartup; }
+    bool isRecording() const { return m_recorder.isRecording(); }
+    bool tracingEnabled() const;
+    void setTracingEnabled(bool enable);
+
+    // Report every action as executed without running it, for trace replays
+    void setStubExecution(bool enable) { m_stubExecution = enable; }
 
     Q_INVOKABLE bool startServer(int port = 8080);
     Q_INVOKABLE void stopServer();
-    Q_INVOKABLE void executeAction(int actionId);
+    Q_INVOKABLE bool startLocalServer();
+    Q_INVOKABLE void stopLocalServer();
+    Q_INVOKABLE void executeAction(int actionId, int relayHops = 0);
     Q_INVOKABLE void showSettings();
     Q_INVOKABLE void setRunAtStartup(bool enable);
+    Q_INVOKABLE QVariantMap injectionMetrics() const { return m_injector.metrics(); }
+    Q_INVOKABLE bool startRecording(const QString &filePath);
+    Q_INVOKABLE void stopRecording();
+    Q_INVOKABLE bool saveTrace(const QString &filePath);
+    Q_INVOKABLE QJsonArray startupReport() const;
 
 signals:
     void isRunningChanged();
     void serverAddressChanged();
     void serverPortChanged();
     void clientCountChanged();
+    void localServerChanged();
     void windowVisibleChanged();
     void clientConnected(const QString &address);
     void clientDisconnected(const QString &address);
@@ -116,26 +173,53 @@ signals:
     void hideWindow();
     void settingsRequested();
     void isRunAtStartupChanged();
+    void isRecordingChanged();
+    void tracingEnabledChanged();
 
 private slots:
     void onNewConnection();
+    void onNewLocalConnection();
     void onClientDisconnected();
     void onClientDataReceived();
     void broadcastActionsUpdate();
     void toggleWindowVisibility();
     void exitApplication();
     void onTrayIconActivated(QSystemTrayIcon::ActivationReason reason);
+    void onWorkerRequestFinished(quint64 requestId, int actionId, bool success, const QString &output);
+    void onRelayCompleted(quint64 jobId, int actionId, int succeeded, int total, double latencyMs);
 
 private:
+    using Completion = std::function<void(bool success, const QString &output)>;
+    using RelayCompletion = std::function<void(int succeeded, int total, double latencyMs)>;
+
+    struct CachedIcon {
+        QDateTime modified;
+        qint64 size = 0;
+        QString data;
+    };
+
     explicit ActionPadServer(QObject *parent = nullptr);
-    void sendActionsToClient(QTcpSocket *client);
-    void processClientMessage(QTcpSocket *client, const QJsonObject &message);
+    void runAction(int actionId, int relayHops, QIODevice *origin, const Completion &done);
+    void addClient(QIODevice *client, const QString &address);
+    void identifyClient(QIODevice *client);
+    void sendActionsToClient(QIODevice *client);
+    QString iconData(const QString &icon);
+    void markAcceptingPresses();
+    QString localSocketName() const;
+    void writeToClient(QIODevice *client, const QByteArray &frame);
+    void processClientMessage(QIODevice *client, const QJsonObject &message);
+    bool canEditLayout(QIODevice *client) const;
+    static bool isClientConnected(QIODevice *client);
+    static QString clientAddress(QIODevice *client);
     void createTrayMenu();
     void setupSystemTray();
 
     static ActionPadServer* m_instance;
     QTcpServer *m_server;
-    QList<QTcpSocket*> m_clients;
+    QLocalServer *m_localServer;
+    QList<QIODevice*> m_clients;
+    QSet<QIODevice*> m_relayClients;
+    QSet<QIODevice*> m_unidentified;    // Connected but not sent the action list yet
     ActionModel m_actionModel;
     QString m_serverAddress;
     int m_serverPort = 8080;
@@ -146,9 +230,19 @@ private:
     QAction *m_settingsAction;
     QAction *m_exitAction;
     bool m_isRunAtStartup{false};
-
-    void executeMediaKey(int mediaKeyIndex);
-    void executeShortcut(const QString &shortcut);
+    InputInjector m_injector;
+    RelayManager m_relay;
+    WorkerPool m_workers;
+    TrafficRecorder m_recorder;
+    quint64 m_inboundRecord = 0;        // Recorder token of the message being processed
+    bool m_stubExecution = false;
+    QHash<quint64, Completion> m_workerPresses;         // WorkerPool request id -> press
+    QHash<quint64, RelayCompletion> m_relayPresses;     // RelayManager job id -> press
+    QHash<QString, CachedIcon> m_iconCache;             // Action icon -> data URL
+    bool m_acceptingPresses = false;
+
+    bool executeMediaKey(int mediaKeyIndex);
+    bool executeShortcut(const QString &shortcut);
 };
 
 #endif // ACTIONPADSERVER_H
@@ -0,0 +1,24 @@
+#ifndef ICONPROVIDER_H
+#define ICONPROVIDER_H
+
+#include <QQuickImageProvider>
+#include <QCache>
+#include <QMutex>
+
+// Decodes action icons at the size they are displayed and keeps the
+// resulting thumbnails in memory. Registered as "image://actionicon/<path>".
+class IconProvider : public QQuickImageProvider
+{
+public:
+    IconProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+    static QString resolvePath(const QString &icon);
+
+private:
+    QCache<QString, QImage> m_cache;
+    QMutex m_mutex;
+};
+
+#endif // ICONPROVIDER_H
@@ -0,0 +1,55 @@
+#ifndef INPUTINJECTOR_H
+#define INPUTINJECTOR_H
+
+#include <QThread>
+#include <QElapsedTimer>
+#include <QVariantMap>
+#include <atomic>
+#include "spscring.h"
+
+struct InjectionRequest {
+    static constexpr int MaxKeys = 8;
+
+    quint16 keys[MaxKeys] = {};
+    int keyCount = 0;
+    bool extended = false;          // Media keys are sent as extended keys
+    quint32 holdMicroseconds = 0;   // Spacing between key down and key up
+    qint64 enqueuedAtNs = 0;
+};
+
+// Injects pre-resolved key presses from a dedicated thread so their timing
+// does not depend on what the GUI event loop is doing. Requests are queued
+// by the main thread only.
+class InputInjector : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit InputInjector(QObject *parent = nullptr);
+    ~InputInjector() override;
+
+    bool enqueue(InjectionRequest request);
+    void stop();
+
+    QVariantMap metrics() const;
+
+protected:
+    void run() override;
+
+private:
+    void inject(const InjectionRequest &request);
+    void waitUntil(qint64 deadlineNs) const;
+
+    SpscRing<InjectionRequest, 256> m_queue;
+    std::atomic<quint32> m_wakeups{0};
+    std::atomic<bool> m_running{true};
+    QElapsedTimer m_clock;
+
+    std::atomic<qint64> m_lastLatencyNs{0};
+    std::atomic<qint64> m_maxLatencyNs{0};
+    std::atomic<qint64> m_totalLatencyNs{0};
+    std::atomic<quint64> m_injectedCount{0};
+    std::atomic<quint64> m_droppedCount{0};
+};
+
+#endif // INPUTINJECTOR_H
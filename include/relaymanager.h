@@ -0,0 +1,77 @@
+#ifndef RELAYMANAGER_H
+#define RELAYMANAGER_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QVariantMap>
+
+// Forwards action presses to other ActionPadServer instances over
+// persistent outbound connections, one per "host:port" target.
+class RelayManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int MaxHops = 4;
+
+    explicit RelayManager(QObject *parent = nullptr);
+    ~RelayManager() override;
+
+    quint64 forward(int actionId, const QStringList &targets, int remoteActionId, int hops);
+    void retainOnly(const QSet<QString> &targets);
+    void setKey(const QString &key) { m_key = key; }
+    QVariantMap metrics() const;
+
+    static QStringList parseTargets(const QString &targets);
+
+signals:
+    void relayCompleted(quint64 jobId, int actionId, int succeeded, int total, double latencyMs);
+
+private:
+    struct Peer {
+        QString host;
+        quint16 port = 0;
+        QTcpSocket *socket = nullptr;
+        QTimer *reconnectTimer = nullptr;
+        int backoffMs = 0;
+        QList<QPair<quint64, QByteArray>> pending;
+        QSet<quint64> inFlight;
+    };
+
+    struct Job {
+        int actionId = 0;
+        int total = 0;
+        int succeeded = 0;
+        int finished = 0;
+        bool dispatching = false;
+        QElapsedTimer timer;
+        QTimer *timeout = nullptr;
+    };
+
+    Peer *peerFor(const QString &target);
+    void connectPeer(Peer *peer);
+    void retire(Peer *peer);
+    void onPeerConnected(Peer *peer);
+    void onPeerDisconnected(Peer *peer);
+    void onPeerReadyRead(Peer *peer);
+    void finishRequest(quint64 requestId, bool success);
+    void finishJob(quint64 jobId);
+
+    QString m_key;                          // Sent in relay_hello when peers require one
+    QHash<QString, Peer*> m_peers;
+    QHash<quint64, Job> m_jobs;
+    QHash<quint64, quint64> m_requestJobs;   // requestId -> jobId
+    quint64 m_nextRequestId = 1;
+    quint64 m_nextJobId = 1;
+
+    quint64 m_completedJobs = 0;
+    double m_lastLatencyMs = 0;
+    double m_totalLatencyMs = 0;
+    double m_maxLatencyMs = 0;
+};
+
+#endif // RELAYMANAGER_H
@@ -0,0 +1,54 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Capacity must be a power of two.
+template <typename T, std::size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+
+public:
+    bool push(const T &item)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        const std::size_t tail = m_tail.load(std::memory_order_acquire);
+        if (head - tail == Capacity)
+            return false;
+
+        m_buffer[head & (Capacity - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        const std::size_t head = m_head.load(std::memory_order_acquire);
+        if (tail == head)
+            return false;
+
+        item = m_buffer[tail & (Capacity - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    // Keep the indices on separate cache lines so producer and consumer
+    // do not invalidate each other on every operation
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    std::array<T, Capacity> m_buffer{};
+};
+
+#endif // SPSCRING_H
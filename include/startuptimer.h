@@ -0,0 +1,13 @@
+#ifndef STARTUPTIMER_H
+#define STARTUPTIMER_H
+
+#include <QJsonArray>
+#include <QString>
+
+namespace StartupTimer {
+void start();
+void mark(const QString &stage);
+QJsonArray report();
+}
+
+#endif // STARTUPTIMER_H
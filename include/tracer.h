@@ -0,0 +1,62 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <atomic>
+
+// Low overhead pipeline tracing. Spans go to a per-thread ring buffer and
+// are written out as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// While tracing is off a span costs one relaxed atomic load.
+namespace Tracer {
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool isEnabled() { return detail::enabled.load(std::memory_order_relaxed); }
+
+// Also starts or stops the event loop watchdog, call from the main thread
+void setEnabled(bool enable);
+// Event loop blocks longer than this are recorded as stalls, 100 ms by default
+void setStallThreshold(int milliseconds);
+
+qint64 now();
+void addSpan(const char *name, qint64 startNs, qint64 endNs);
+bool dump(const QString &filePath);
+
+class Span
+{
+public:
+    explicit Span(const char *name)
+    {
+        if (isEnabled())
+            begin(name);
+    }
+
+    ~Span()
+    {
+        if (m_name)
+            end();
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+private:
+    void begin(const char *name);
+    void end();
+
+    const char *m_name = nullptr;
+    const char *m_parent = nullptr;
+    qint64 m_startNs = 0;
+};
+
+} // namespace Tracer
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Names must be string literals, only the pointer is stored
+#define TRACE_SCOPE(name) Tracer::Span TRACE_CONCAT(traceSpan_, __LINE__)(name)
+
+#endif // TRACER_H
@@ -0,0 +1,63 @@
+#ifndef TRAFFICRECORDER_H
+#define TRAFFICRECORDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QHash>
+
+struct TraceRecord {
+    enum Kind : quint8 {
+        Inbound = 0,
+        Outbound = 1,
+        Connected = 2,
+        Disconnected = 3,
+        Completed = 4           // An inbound press finished executing
+    };
+
+    Kind kind = Inbound;
+    quint32 connectionId = 0;
+    qint64 timestampUs = 0;     // Since the start of the recording
+    QByteArray payload;
+    qsizetype request = -1;     // Completed: index of the inbound record in the trace
+    bool success = false;       // Completed: outcome of the press
+};
+
+// Appends timestamped client traffic to a binary trace file.
+//
+// File layout, little endian: the "APTR" magic and a quint16 version, then
+// records of { quint8 kind, quint32 connection, qint64 timestampUs,
+// quint32 length, payload }. Each recording session appends its own header.
+// A Completed record has connection 0 and a { quint32 record, quint8 success }
+// payload, record being the position of the press in its session.
+class TrafficRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr quint16 FormatVersion = 2;
+
+    explicit TrafficRecorder(QObject *parent = nullptr);
+
+    bool start(const QString &filePath);
+    void stop();
+    bool isRecording() const { return m_file.isOpen(); }
+
+    // Returns a token for recordCompletion(), 0 while not recording
+    quint64 record(TraceRecord::Kind kind, const QObject *connection, const QByteArray &payload = {});
+    void recordCompletion(quint64 request, bool success);
+
+    static bool readTrace(const QString &filePath, QList<TraceRecord> &records);
+
+private:
+    QFile m_file;
+    QElapsedTimer m_clock;
+    QHash<const QObject*, quint32> m_connectionIds;
+    quint32 m_nextConnectionId = 1;
+    quint32 m_session = 0;
+    quint32 m_nextRecord = 0;
+
+    void write(TraceRecord::Kind kind, quint32 connectionId, const QByteArray &payload);
+};
+
+#endif // TRAFFICRECORDER_H
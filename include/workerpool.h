@@ -0,0 +1,85 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QVariantMap>
+
+// Keeps one long-lived process per distinct command line and sends it
+// presses over stdin, so persistent command actions skip process startup.
+//
+// Line protocol, one message per line:
+//   server -> worker:  "press <requestId> <actionId>", "ping <id>", "quit"
+//   worker -> server:  "done <requestId> <exitCode> [output]", "pong <id>"
+// Any other output line is ignored. Workers that exit, stop answering pings
+// or take too long on a press are restarted with a backoff, but only once
+// there is a press for them. A worker that keeps failing is given up on and
+// its presses are reported as failed, until it is retried after the longest
+// backoff.
+class WorkerPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WorkerPool(QObject *parent = nullptr);
+    ~WorkerPool() override;
+
+    quint64 submit(int actionId, const QString &program, const QString &arguments);
+    void retainOnly(const QSet<QString> &commandLines);
+    void shutdown();
+
+    QVariantMap metrics() const;
+
+    static QString commandLine(const QString &program, const QString &arguments);
+
+signals:
+    void requestFinished(quint64 requestId, int actionId, bool success, const QString &output);
+
+private:
+    struct Request {
+        int actionId = 0;
+        qint64 sentAtNs = 0;
+        bool written = false;               // Reached the process, not just the queue
+    };
+
+    struct Worker {
+        QString program;
+        QStringList arguments;
+        QProcess *process = nullptr;
+        QTimer *restartTimer = nullptr;
+        int backoffMs = 0;
+        int failures = 0;                   // Exits since the last answer from the worker
+        qint64 exitedAtNs = 0;
+        bool started = false;
+        QList<QByteArray> queued;           // Written once the process has started
+        QHash<quint64, Request> pending;
+        quint64 pingId = 0;
+        qint64 pingSentAtNs = 0;
+    };
+
+    Worker *workerFor(const QString &program, const QString &arguments);
+    void startWorker(Worker *worker);
+    void scheduleStart(Worker *worker);
+    void retire(Worker *worker);
+    void send(Worker *worker, const QByteArray &line);
+    void onWorkerOutput(Worker *worker);
+    void onWorkerFinished(Worker *worker);
+    void checkHealth();
+
+    QHash<QString, Worker*> m_workers;
+    QTimer m_healthTimer;
+    QElapsedTimer m_clock;
+    quint64 m_nextRequestId = 1;
+    bool m_shuttingDown = false;
+
+    quint64 m_completed = 0;
+    quint64 m_restarts = 0;
+    quint64 m_unavailable = 0;
+    double m_lastLatencyMs = 0;
+};
+
+#endif // WORKERPOOL_H
@@ -16,6 +16,9 @@ Popup {
     property alias actionType: typeComboBox.currentIndex
     property alias mediaKey: mediaKeyComboBox.currentIndex
     property alias shortcutKey: shortcutField.text
+    property alias relayTargets: relayTargetsField.text
+    property alias relayActionId: relayActionIdSpinBox.value
+    property alias persistent: persistentCheckBox.checked
     property bool isModifying: false
     property int labelWidth: 100
     Material.background: UserSettings.darkMode ? "#1C1C1C" : "#E3E3E3"
@@ -73,7 +76,7 @@ Popup {
                     id: typeComboBox
                     Layout.fillWidth: true
                     Layout.columnSpan: 2
-                    model: ["Command", "Media Key", "Shortcut"]
+                    model: ["Command", "Media Key", "Shortcut", "Relay"]
                     currentIndex: 0
                 }
 
@@ -140,6 +143,22 @@ Popup {
                     Layout.columnSpan: 2
                     placeholderText: "Command arguments (optional)"
                 }
+
+                CheckBox {
+                    id: persistentCheckBox
+                    Layout.columnSpan: 3
+                    text: "Keep running as a persistent worker"
+                }
+
+                Label {
+                    Layout.columnSpan: 3
+                    visible: persistentCheckBox.checked
+                    text: "The command is started once and receives \"press <request> <action>\" lines on stdin. It must answer each with \"done <request> <exit code> [output]\" and reply \"pong <id>\" to \"ping <id>\"."
+                    font.pixelSize: 10
+                    opacity: 0.7
+                    wrapMode: Text.WordWrap
+                    Layout.fillWidth: true
+                }
             }
         }
 
@@ -419,6 +438,56 @@ Popup {
             }
         }
 
+        Pane {
+            Layout.fillWidth: true
+            Material.background: UserSettings.darkMode ? "#2B2B2B" : "#FFFFFF"
+            Material.elevation: 6
+            Material.roundedScale: Material.ExtraSmallScale
+            visible: typeComboBox.currentIndex === 3
+
+            // Relay layout
+            GridLayout {
+                id: relayLayout
+                anchors.fill: parent
+                columns: 2
+                columnSpacing: 10
+                rowSpacing: 10
+
+                Label {
+                    text: "Targets:"
+                    Layout.preferredWidth: popup.labelWidth
+                }
+                TextField {
+                    Layout.preferredHeight: 35
+                    id: relayTargetsField
+                    Layout.fillWidth: true
+                    placeholderText: "host:port, host:port"
+                }
+
+                Label {
+                    text: "Remote action:"
+                    Layout.preferredWidth: popup.labelWidth
+                }
+                SpinBox {
+                    id: relayActionIdSpinBox
+                    Layout.preferredHeight: implicitHeight - 6
+                    from: 0
+                    to: 99999
+                    value: 0
+                    editable: true
+                }
+
+                Label {
+                    Layout.columnSpan: 2
+                    text: "Presses are forwarded to every target. Remote action 0 uses this action's id."
+                    font.pixelSize: 10
+                    opacity: 0.7
+                    wrapMode: Text.WordWrap
+                    Layout.fillWidth: true
+                }
+            }
+        }
+
         // Buttons
         RowLayout {
             Layout.fillWidth: true
@@ -460,6 +529,8 @@ Popup {
             return mediaKeyComboBox.currentIndex >= 0
         } else if (typeComboBox.currentIndex === 2) { // Shortcut
             return shortcutField.text.length > 0
+        } else if (typeComboBox.currentIndex === 3) { // Relay
+            return relayTargetsField.text.trim().length > 0
         }
         return false
     }
@@ -514,6 +585,9 @@ Popup {
         argumentsField.text = ""
         iconField.text = ""
         shortcutField.text = ""
+        relayTargetsField.text = ""
+        relayActionIdSpinBox.value = 0
+        persistentCheckBox.checked = false
         typeComboBox.currentIndex = 0
         mediaKeyComboBox.currentIndex = 0
 
@@ -531,11 +605,14 @@ Popup {
         isModifying = false
     }
 
-    function setFieldsFromAction(name, command, args, icon, type, mediaKey, shortcut) {
+    function setFieldsFromAction(name, command, args, icon, type, mediaKey, shortcut, targets, remoteActionId, isPersistent) {
         nameField.text = name || ""
         commandField.text = command || ""
         argumentsField.text = args || ""
         iconField.text = icon || ""
+        relayTargetsField.text = targets || ""
+        relayActionIdSpinBox.value = remoteActionId || 0
+        persistentCheckBox.checked = isPersistent || false
         typeComboBox.currentIndex = type || 0
         mediaKeyComboBox.currentIndex = mediaKey || 0
 
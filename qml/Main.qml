@@ -33,10 +33,22 @@ ApplicationWindow {
         }
 
         function onSettingsRequested() {
+            const settingsWindow = window.getSettingsWindow()
             settingsWindow.visible = !settingsWindow.visible
         }
     }
 
+    // Dialogs are only created the first time they are needed
+    function getActionDialog() {
+        actionDialogLoader.active = true
+        return actionDialogLoader.item
+    }
+
+    function getSettingsWindow() {
+        settingsWindowLoader.active = true
+        return settingsWindowLoader.item
+    }
+
     header: ToolBar {
         Material.elevation: 6
         Material.background: UserSettings.darkMode ? "#2B2B2B" : "#FFFFFF"
@@ -49,6 +61,7 @@ ApplicationWindow {
             icon.color: UserSettings.darkMode ? "white" : "black"
             anchors.verticalCenter: parent.verticalCenter
             onClicked: {
+                const actionDialog = window.getActionDialog()
                 actionDialog.isModifying = false
                 actionDialog.clearFields()
                 actionDialog.open()
@@ -72,60 +85,97 @@ ApplicationWindow {
             icon.color: UserSettings.darkMode ? "white" : "black"
             anchors.verticalCenter: parent.verticalCenter
             onClicked: {
-                settingsWindow.show()
+                window.getSettingsWindow().show()
             }
         }
     }
 
-    ActionDialog {
-        id: actionDialog
-
-        property int modifyingIndex: -1
-
-        onCreateAction: {
-            ActionPadServer.actionModel.addAction(
-                actionName,
-                command,
-                commandArgs,
-                icon,
-                actionType,
-                mediaKey,
-                shortcutKey
-            )
-            clearFields()
-        }
+    Loader {
+        id: actionDialogLoader
+        active: false
+        sourceComponent: Component {
+            ActionDialog {
+                parent: window.contentItem
+
+                property int modifyingIndex: -1
+
+                onCreateAction: {
+                    ActionPadServer.actionModel.addAction(
+                        actionName,
+                        command,
+                        commandArgs,
+                        icon,
+                        actionType,
+                        mediaKey,
+                        shortcutKey,
+                        relayTargets,
+                        relayActionId,
+                        persistent
+                    )
+                    clearFields()
+                }
+
+                onSaveAction: {
+                    ActionPadServer.actionModel.updateAction(
+                        modifyingIndex,
+                        actionName,
+                        command,
+                        commandArgs,
+                        icon,
+                        actionType,
+                        mediaKey,
+                        shortcutKey,
+                        relayTargets,
+                        relayActionId,
+                        persistent
+                    )
+                    clearFields()
+                }
 
-        onSaveAction: {
-            ActionPadServer.actionModel.updateAction(
-                modifyingIndex,
-                actionName,
-                command,
-                commandArgs,
-                icon,
-                actionType,
-                mediaKey,
-                shortcutKey
-            )
-            clearFields()
+                onDeleteAction: {
+                    ActionPadServer.actionModel.removeAction(modifyingIndex)
+                    clearFields()
+                }
+            }
         }
+    }
 
-        onDeleteAction: {
-            ActionPadServer.actionModel.removeAction(modifyingIndex)
-            clearFields()
+    Loader {
+        id: settingsWindowLoader
+        active: false
+        sourceComponent: Component {
+            SettingsWindow {}
         }
     }
 
-    SettingsWindow {
-        id: settingsWindow
+    ActionFilterModel {
+        id: filteredActions
+        sourceModel: ActionPadServer.actionModel
+        filterText: searchField.text
+    }
+
+    TextField {
+        id: searchField
+        anchors.top: parent.top
+        anchors.left: parent.left
+        anchors.right: parent.right
+        anchors.margins: 20
+        placeholderText: "Search actions"
     }
 
     GridView {
         id: actionsGrid
-        anchors.fill: parent
+        anchors.top: searchField.bottom
+        anchors.left: parent.left
+        anchors.right: parent.right
+        anchors.bottom: parent.bottom
         anchors.margins: 20
-        model: ActionPadServer.actionModel
+        clip: true
+        model: filteredActions
         cellWidth: 120
         cellHeight: 120
+        reuseItems: true
+        cacheBuffer: cellHeight * 2
         delegate: Button {
             id: actionButton
             width: actionsGrid.cellWidth - 10
@@ -135,8 +185,9 @@ ApplicationWindow {
             required property var model
             required property int index
             onClicked: {
+                const actionDialog = window.getActionDialog()
                 actionDialog.isModifying = true
-                actionDialog.modifyingIndex = index
+                actionDialog.modifyingIndex = filteredActions.sourceRow(index)
                 actionDialog.setFieldsFromAction(
                     model.name,
                     model.command || "",
@@ -144,7 +195,10 @@ ApplicationWindow {
                     model.icon || "",
                     model.type || 0,
                     model.mediaKey || 0,
-                    model.shortcut || ""
+                    model.shortcut || "",
+                    model.relayTargets || "",
+                    model.relayActionId || 0,
+                    model.persistent || false
                 )
                 actionDialog.open()
             }
@@ -159,7 +213,11 @@ ApplicationWindow {
                     Layout.preferredWidth: 48
                     Layout.preferredHeight: 48
                     source: actionButton.model.icon && actionButton.model.icon.length > 0 ?
-                            actionButton.model.icon : "qrc:/icons/placeholder.png"
+                            "image://actionicon/" + encodeURIComponent(actionButton.model.icon).split("%").join("$") :
+                            "qrc:/icons/placeholder.png"
+                    sourceSize.width: 48
+                    sourceSize.height: 48
+                    asynchronous: true
                     fillMode: Image.PreserveAspectFit
                     color: (!actionButton.model.icon || actionButton.model.icon.length === 0) ?
                            (UserSettings.darkMode ? "white" : "black") : "transparent"
@@ -4,6 +4,7 @@ import QtQuick
 import QtQuick.Layouts
 import QtQuick.Controls.Material
 import QtQuick.Controls.impl
+import QtQuick.Dialogs
 import Odizinne.ActionPadServer 1.0
 
 ApplicationWindow {
@@ -89,6 +90,39 @@ ApplicationWindow {
                     }
                 }
 
+                RowLayout {
+                    Layout.preferredHeight: window.rowHeight
+                    Label {
+                        text: "Local socket"
+                        Layout.fillWidth: true
+                    }
+
+                    Switch {
+                        checked: ActionPadServer.isLocalServerRunning
+                        onClicked: {
+                            UserSettings.localServer = checked
+                            if (checked) {
+                                ActionPadServer.startLocalServer()
+                            } else {
+                                ActionPadServer.stopLocalServer()
+                            }
+                        }
+                    }
+                }
+
+                RowLayout {
+                    Layout.preferredHeight: window.rowHeight
+                    Label {
+                        text: "Allow network clients to edit actions"
+                        Layout.fillWidth: true
+                    }
+
+                    Switch {
+                        checked: UserSettings.allowRemoteLayoutEdits
+                        onClicked: UserSettings.allowRemoteLayoutEdits = checked
+                    }
+                }
+
                 RowLayout {
                     Layout.preferredHeight: window.rowHeight
                     Label {
@@ -163,6 +197,43 @@ ApplicationWindow {
                         onClicked: UserSettings.windowVisibleStartup = checked
                     }
                 }
+                RowLayout {
+                    Layout.preferredHeight: window.rowHeight
+                    Label {
+                        text: "Pipeline tracing"
+                        Layout.fillWidth: true
+                    }
+
+                    ToolButton {
+                        text: "Save trace"
+                        onClicked: traceFileDialog.open()
+                    }
+
+                    Switch {
+                        checked: ActionPadServer.tracingEnabled
+                        onClicked: ActionPadServer.tracingEnabled = checked
+                    }
+                }
+
+                RowLayout {
+                    Layout.preferredHeight: window.rowHeight
+                    Button {
+                        Material.elevation: 0
+                        Material.roundedScale: Material.ExtraSmallScale
+                        Layout.fillWidth: true
+                        text: "Import actions"
+                        onClicked: importFileDialog.open()
+                    }
+
+                    Button {
+                        Material.elevation: 0
+                        Material.roundedScale: Material.ExtraSmallScale
+                        Layout.fillWidth: true
+                        text: "Export actions"
+                        onClicked: exportFileDialog.open()
+                    }
+                }
+
                 RowLayout {
                     Layout.preferredHeight: window.rowHeight
 
@@ -236,4 +307,29 @@ ApplicationWindow {
             }
         }
     }
+
+    FileDialog {
+        id: importFileDialog
+        title: "Import Actions"
+        nameFilters: ["JSON files (*.json)", "All files (*)"]
+        onAccepted: ActionPadServer.actionModel.importFromFile(selectedFile, false)
+    }
+
+    FileDialog {
+        id: exportFileDialog
+        title: "Export Actions"
+        fileMode: FileDialog.SaveFile
+        defaultSuffix: "json"
+        nameFilters: ["JSON files (*.json)"]
+        onAccepted: ActionPadServer.actionModel.exportToFile(selectedFile)
+    }
+
+    FileDialog {
+        id: traceFileDialog
+        title: "Save Trace"
+        fileMode: FileDialog.SaveFile
+        defaultSuffix: "json"
+        nameFilters: ["Chrome trace (*.json)"]
+        onAccepted: ActionPadServer.saveTrace(selectedFile)
+    }
 }
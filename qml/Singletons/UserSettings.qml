@@ -7,4 +7,6 @@ Settings {
     property bool darkMode: true
     property bool windowVisibleStartup: true
     property bool autostartServer: false
+    property bool localServer: true
+    property bool allowRemoteLayoutEdits: false
 }
@@ -0,0 +1,99 @@
+#include "actionfiltermodel.h"
+#include "actionpadserver.h"
+
+ActionFilterModel::ActionFilterModel(QObject *parent)
+    : QSortFilterProxyModel(parent)
+{
+    // Coalesce keystrokes so typing a word filters once, not once per letter
+    m_debounceTimer.setSingleShot(true);
+    m_debounceTimer.setInterval(120);
+    connect(&m_debounceTimer, &QTimer::timeout, this, &ActionFilterModel::applyFilter);
+    connect(this, &QSortFilterProxyModel::sourceModelChanged, this, &ActionFilterModel::watchSourceModel);
+}
+
+void ActionFilterModel::watchSourceModel()
+{
+    m_accepted.clear();
+    if (!sourceModel())
+        return;
+
+    // Row numbers shift with these, forget the cached results
+    auto forget = [this]() { m_accepted.clear(); };
+    connect(sourceModel(), &QAbstractItemModel::rowsInserted, this, forget);
+    connect(sourceModel(), &QAbstractItemModel::rowsRemoved, this, forget);
+    connect(sourceModel(), &QAbstractItemModel::rowsMoved, this, forget);
+    connect(sourceModel(), &QAbstractItemModel::modelReset, this, forget);
+    connect(sourceModel(), &QAbstractItemModel::layoutChanged, this, forget);
+}
+
+void ActionFilterModel::setFilterText(const QString &text)
+{
+    if (m_filterText == text)
+        return;
+
+    m_filterText = text;
+    emit filterTextChanged();
+
+    // Clearing the search should show everything again immediately
+    if (text.isEmpty()) {
+        m_debounceTimer.stop();
+        applyFilter();
+    } else {
+        m_debounceTimer.start();
+    }
+}
+
+void ActionFilterModel::applyFilter()
+{
+    const QString text = m_filterText.trimmed();
+    if (text == m_appliedText)
+        return;
+
+    // Filtering matches substrings, so text containing the previous text can
+    // only hide rows: re-test the accepted ones and skip the rest
+    const int rows = sourceModel() ? sourceModel()->rowCount() : 0;
+    m_narrowing = !m_appliedText.isEmpty()
+                  && text.contains(m_appliedText, Qt::CaseInsensitive)
+                  && m_accepted.size() == rows;
+    if (!m_narrowing)
+        m_accepted = QList<bool>(rows, text.isEmpty());
+
+    m_appliedText = text;
+    // Only rows are filtered, there are no columns or sorting to rebuild
+    invalidateRowsFilter();
+    m_narrowing = false;
+}
+
+int ActionFilterModel::sourceRow(int proxyRow) const
+{
+    return mapToSource(index(proxyRow, 0)).row();
+}
+
+bool ActionFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent)
+
+    if (m_appliedText.isEmpty())
+        return true;
+
+    // Read the backing list directly instead of going through QVariant roles
+    const ActionModel *model = qobject_cast<const ActionModel*>(sourceModel());
+    if (!model)
+        return true;
+
+    const auto &actions = model->getActions();
+    if (sourceRow < 0 || sourceRow >= actions.size())
+        return false;
+
+    const bool cached = sourceRow < m_accepted.size();
+    if (m_narrowing && cached && !m_accepted[sourceRow])
+        return false;
+
+    const Action &action = actions[sourceRow];
+    const bool accepted = action.name.contains(m_appliedText, Qt::CaseInsensitive)
+                          || action.command.contains(m_appliedText, Qt::CaseInsensitive)
+                          || action.shortcut.contains(m_appliedText, Qt::CaseInsensitive);
+    if (cached)
+        m_accepted[sourceRow] = accepted;
+    return accepted;
+}
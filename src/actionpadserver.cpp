@@ -8,7 +8,22 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QCoreApplication>
+#include <QSet>
+#include <QTimer>
+#include <QUrl>
 #include "shortcutmanager.h"
+#include "startuptimer.h"
+#include "tracer.h"
+
+namespace {
+// Largest message accepted without a trailing newline, an action list
+// import is the biggest thing a client sends
+constexpr qint64 MaxUnterminatedBytes = 1024 * 1024;
+
+// How long a new connection has to identify itself before it is sent the
+// action list, relays say hello right after connecting
+constexpr int IdentifyTimeoutMs = 250;
+}
 
 ActionModel::ActionModel(QObject *parent) : QAbstractListModel(parent)
 {
@@ -37,7 +52,9 @@ ActionPadServer* ActionPadServer::instance()
 
 void ActionModel::addAction(const QString &name, const QString &command,
                             const QString &arguments, const QString &icon,
-                            int type, int mediaKey, const QString &shortcut)
+                            int type, int mediaKey, const QString &shortcut,
+                            const QString &relayTargets, int relayActionId,
+                            bool persistent)
 {
     beginInsertRows(QModelIndex(), rowCount(), rowCount());
 
@@ -50,17 +67,21 @@ void ActionModel::addAction(const QString &name, const QString &command,
     action.type = type;
     action.mediaKey = mediaKey;
     action.shortcut = shortcut;
+    action.relayTargets = relayTargets;
+    action.relayActionId = relayActionId;
+    action.persistent = persistent;
 
     m_actions.append(action);
     endInsertRows();
 
-    saveToSettings();
-    emit actionsChanged();
+    commitChanges();
 }
 
 void ActionModel::updateAction(int index, const QString &name, const QString &command,
                                const QString &arguments, const QString &icon,
-                               int type, int mediaKey, const QString &shortcut)
+                               int type, int mediaKey, const QString &shortcut,
+                               const QString &relayTargets, int relayActionId,
+                               bool persistent)
 {
     if (index < 0 || index >= m_actions.size())
         return;
@@ -72,12 +93,14 @@ void ActionModel::updateAction(int index, const QString &name, const QString &co
     m_actions[index].type = type;
     m_actions[index].mediaKey = mediaKey;
     m_actions[index].shortcut = shortcut;
+    m_actions[index].relayTargets = relayTargets;
+    m_actions[index].relayActionId = relayActionId;
+    m_actions[index].persistent = persistent;
 
     emit dataChanged(this->index(index), this->index(index));
 
     // Auto-save after updating
-    saveToSettings();
-    emit actionsChanged();
+    commitChanges();
 }
 
 void ActionModel::removeAction(int index)
@@ -90,10 +113,218 @@ void ActionModel::removeAction(int index)
     endRemoveRows();
 
     // Auto-save after removing
+    commitChanges();
+}
+
+void ActionModel::beginBatch()
+{
+    ++m_batchDepth;
+}
+
+void ActionModel::commitBatch()
+{
+    if (m_batchDepth == 0)
+        return;
+
+    if (--m_batchDepth == 0 && m_batchDirty) {
+        m_batchDirty = false;
+        saveToSettings();
+        emit actionsChanged();
+    }
+}
+
+void ActionModel::commitChanges()
+{
+    if (m_batchDepth > 0) {
+        m_batchDirty = true;
+        return;
+    }
+
     saveToSettings();
     emit actionsChanged();
 }
 
+int ActionModel::indexOfAction(int actionId) const
+{
+    for (int i = 0; i < m_actions.size(); ++i) {
+        if (m_actions[i].id == actionId)
+            return i;
+    }
+    return -1;
+}
+
+Action ActionModel::actionFromJson(const QJsonObject &obj)
+{
+    Action action;
+    action.id = obj["id"].toInt();
+    action.name = obj["name"].toString();
+    action.command = obj["command"].toString();
+    action.arguments = obj["arguments"].toString();
+    action.icon = obj["icon"].toString();
+    action.type = obj["type"].toInt(0);
+    action.mediaKey = obj["mediaKey"].toInt(0);
+    action.shortcut = obj["shortcut"].toString();
+    action.relayTargets = obj["relayTargets"].toString();
+    action.relayActionId = obj["relayActionId"].toInt(0);
+    action.persistent = obj["persistent"].toBool(false);
+    return action;
+}
+
+QJsonObject ActionModel::actionToJson(const Action &action)
+{
+    QJsonObject obj;
+    obj["id"] = action.id;
+    obj["name"] = action.name;
+    obj["command"] = action.command;
+    obj["arguments"] = action.arguments;
+    obj["icon"] = action.icon;
+    obj["type"] = action.type;
+    obj["mediaKey"] = action.mediaKey;
+    obj["shortcut"] = action.shortcut;
+    obj["relayTargets"] = action.relayTargets;
+    obj["relayActionId"] = action.relayActionId;
+    obj["persistent"] = action.persistent;
+    return obj;
+}
+
+int ActionModel::importActions(const QJsonArray &actions, bool replace)
+{
+    QList<Action> imported;
+    imported.reserve(actions.size());
+
+    for (const QJsonValue &value : actions) {
+        if (!value.isObject())
+            continue;
+        Action action = actionFromJson(value.toObject());
+        if (action.name.isEmpty())
+            continue;
+        imported.append(action);
+    }
+
+    // Replacing with nothing would wipe the whole layout, never allow it
+    if (imported.isEmpty())
+        return 0;
+
+    if (replace) {
+        // Keep the ids of a replaced layout so pads can keep pressing them,
+        // falling back to fresh ids for missing or duplicated ones. Ids are
+        // never handed out twice, a pad may still hold one of a deleted action
+        beginResetModel();
+        m_actions.clear();
+        QSet<int> usedIds;
+        int maxId = 0;
+        for (const Action &action : imported) {
+            if (action.id > 0 && !usedIds.contains(action.id)) {
+                usedIds.insert(action.id);
+                maxId = qMax(maxId, action.id);
+            }
+        }
+        m_nextId = qMax(m_nextId, maxId + 1);
+        usedIds.clear();
+        for (Action action : imported) {
+            if (action.id <= 0 || usedIds.contains(action.id))
+                action.id = m_nextId++;
+            usedIds.insert(action.id);
+            m_actions.append(action);
+        }
+        endResetModel();
+    } else {
+        const int first = m_actions.size();
+        beginInsertRows(QModelIndex(), first, first + imported.size() - 1);
+        for (Action action : imported) {
+            action.id = m_nextId++;
+            m_actions.append(action);
+        }
+        endInsertRows();
+    }
+
+    commitChanges();
+    return imported.size();
+}
+
+QJsonArray ActionModel::exportActions() const
+{
+    QJsonArray array;
+    for (const auto &action : m_actions) {
+        array.append(actionToJson(action));
+    }
+    return array;
+}
+
+int ActionModel::applyOperations(const QJsonArray &operations)
+{
+    int applied = 0;
+    beginBatch();
+
+    for (const QJsonValue &value : operations) {
+        const QJsonObject op = value.toObject();
+        const QString kind = op["op"].toString();
+        const int index = op.contains("index") ? op["index"].toInt(-1)
+                                               : indexOfAction(op["id"].toInt(-1));
+
+        if (kind == "add") {
+            addAction(op["name"].toString(), op["command"].toString(),
+                      op["arguments"].toString(), op["icon"].toString(),
+                      op["type"].toInt(0), op["mediaKey"].toInt(0),
+                      op["shortcut"].toString(), op["relayTargets"].toString(),
+                      op["relayActionId"].toInt(0), op["persistent"].toBool(false));
+        } else if (kind == "update" && index >= 0 && index < m_actions.size()) {
+            // Fields missing from the operation keep their current value
+            QJsonObject fields = actionToJson(m_actions[index]);
+            for (auto it = op.constBegin(); it != op.constEnd(); ++it) {
+                if (it.key() != "op" && it.key() != "index" && it.key() != "id")
+                    fields[it.key()] = it.value();
+            }
+            const Action action = actionFromJson(fields);
+            updateAction(index, action.name, action.command, action.arguments, action.icon,
+                         action.type, action.mediaKey, action.shortcut, action.relayTargets,
+                         action.relayActionId, action.persistent);
+        } else if (kind == "remove" && index >= 0 && index < m_actions.size()) {
+            removeAction(index);
+        } else {
+            continue;
+        }
+        ++applied;
+    }
+
+    commitBatch();
+    return applied;
+}
+
+int ActionModel::importFromFile(const QString &filePath, bool replace)
+{
+    QString localPath = QUrl(filePath).toLocalFile();
+    if (localPath.isEmpty())
+        localPath = filePath;
+
+    QFile file(localPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (doc.isArray())
+        return importActions(doc.array(), replace);
+    if (doc.isObject())
+        return importActions(doc.object()["actions"].toArray(), replace);
+
+    return -1;
+}
+
+bool ActionModel::exportToFile(const QString &filePath) const
+{
+    QString localPath = QUrl(filePath).toLocalFile();
+    if (localPath.isEmpty())
+        localPath = filePath;
+
+    QFile file(localPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QJsonObject root;
+    root["actions"] = exportActions();
+    return file.write(QJsonDocument(root).toJson(QJsonDocument::Indented)) != -1;
+}
+
 int ActionModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
@@ -116,6 +347,9 @@ QVariant ActionModel::data(const QModelIndex &index, int role) const
     case TypeRole: return action.type;           // Add this
     case MediaKeyRole: return action.mediaKey;   // Add this
     case ShortcutRole: return action.shortcut;   // Add this
+    case RelayTargetsRole: return action.relayTargets;
+    case RelayActionIdRole: return action.relayActionId;
+    case PersistentRole: return action.persistent;
     }
 
     return QVariant();
@@ -132,6 +366,9 @@ QHash<int, QByteArray> ActionModel::roleNames() const
     roles[TypeRole] = "type";           // Add this
     roles[MediaKeyRole] = "mediaKey";   // Add this
     roles[ShortcutRole] = "shortcut";   // Add this
+    roles[RelayTargetsRole] = "relayTargets";
+    roles[RelayActionIdRole] = "relayActionId";
+    roles[PersistentRole] = "persistent";
     return roles;
 }
 
@@ -155,6 +392,9 @@ void ActionModel::saveToSettings()
         settings.setValue("type", m_actions[i].type);
         settings.setValue("mediaKey", m_actions[i].mediaKey);
         settings.setValue("shortcut", m_actions[i].shortcut);
+        settings.setValue("relayTargets", m_actions[i].relayTargets);
+        settings.setValue("relayActionId", m_actions[i].relayActionId);
+        settings.setValue("persistent", m_actions[i].persistent);
     }
 
     settings.endArray();
@@ -180,6 +420,9 @@ void ActionModel::loadFromSettings()
         action.type = settings.value("type", 0).toInt();
         action.mediaKey = settings.value("mediaKey", 0).toInt();
         action.shortcut = settings.value("shortcut").toString();
+        action.relayTargets = settings.value("relayTargets").toString();
+        action.relayActionId = settings.value("relayActionId", 0).toInt();
+        action.persistent = settings.value("persistent", false).toBool();
         m_actions.append(action);
     }
 
@@ -192,6 +435,7 @@ void ActionModel::loadFromSettings()
 ActionPadServer::ActionPadServer(QObject *parent)
     : QObject(parent)
     , m_server(new QTcpServer(this))
+    , m_localServer(new QLocalServer(this))
     , m_windowVisible(true)
     , m_trayIcon(nullptr)
     , m_trayMenu(nullptr)
@@ -203,21 +447,76 @@ ActionPadServer::ActionPadServer(QObject *parent)
     QSettings settings("Odizinne", "ActionPadServer");
     m_windowVisible = settings.value("windowVisibleStartup", true).toBool();
 
-    setupSystemTray();
-
-    m_server = new QTcpServer(this);
     connect(m_server, &QTcpServer::newConnection, this, &ActionPadServer::onNewConnection);
+    connect(m_localServer, &QLocalServer::newConnection, this, &ActionPadServer::onNewLocalConnection);
 
     // Connect to ActionModel changes to broadcast updates
     connect(&m_actionModel, &ActionModel::actionsChanged, this, &ActionPadServer::broadcastActionsUpdate);
 
     // Load saved actions on startup
     m_actionModel.loadActions();
-
+    StartupTimer::mark("Actions loaded");
+
+    m_relay.setKey(settings.value("relayKey").toString());
+    connect(&m_relay, &RelayManager::relayCompleted, this, &ActionPadServer::onRelayCompleted);
+    connect(&m_workers, &WorkerPool::requestFinished, this, &ActionPadServer::onWorkerRequestFinished);
+
+    // Stop workers and relay peers that no action uses anymore
+    connect(&m_actionModel, &ActionModel::actionsChanged, this, [this]() {
+        QSet<QString> commandLines;
+        QSet<QString> relayTargets;
+        for (const Action &action : m_actionModel.getActions()) {
+            if (action.type == 0 && action.persistent)
+                commandLines.insert(WorkerPool::commandLine(action.command, action.arguments));
+            if (action.type == 3) {
+                for (const QString &target : RelayManager::parseTargets(action.relayTargets)) {
+                    relayTargets.insert(target);
+                }
+            }
+        }
+        m_workers.retainOnly(commandLines);
+        m_relay.retainOnly(relayTargets);
+    });
+
+    // Forget encoded icons no action shows anymore
+    connect(&m_actionModel, &ActionModel::actionsChanged, this, [this]() {
+        QSet<QString> icons;
+        for (const Action &action : m_actionModel.getActions()) {
+            icons.insert(action.icon);
+        }
+        m_iconCache.removeIf([&icons](QHash<QString, CachedIcon>::iterator it) {
+            return !icons.contains(it.key());
+        });
+    });
+
+    // Key presses are injected from their own thread, stop it before exit
+    m_injector.start(QThread::HighestPriority);
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [this]() {
+        m_injector.stop();
+        m_workers.shutdown();
+        // The server may never be destroyed when QML did not take ownership of it
+        m_recorder.stop();
+        // Joins the watchdog thread while its heartbeat timer can still be deleted
+        Tracer::setEnabled(false);
+    });
+
+    // The local socket is named after this port, even before the TCP server starts
+    m_serverPort = settings.value("port", 8080).toInt();
+
+    // Same-host clients can connect without the network server running
+    if (settings.value("localServer", true).toBool()) {
+        startLocalServer();
+    }
 
     if (settings.value("autostartServer", false).toBool()) {
         startServer(settings.value("port", 8080).toInt());
     }
+
+    // The tray is not needed to serve presses, create it once the event loop runs
+    QTimer::singleShot(0, this, [this]() {
+        setupSystemTray();
+        StartupTimer::mark("Tray ready");
+    });
 }
 
 bool ActionPadServer::startServer(int port)
@@ -230,6 +529,13 @@ bool ActionPadServer::startServer(int port)
     if (!m_server->listen(QHostAddress::Any, port)) {
         return false;
     }
+    markAcceptingPresses();
+
+    // Keep the local socket name in step with the port actually listening
+    if (m_localServer->isListening() && m_localServer->serverName() != localSocketName()) {
+        stopLocalServer();
+        startLocalServer();
+    }
 
     // Get local IP address
     foreach (const QHostAddress &address, QNetworkInterface::allAddresses()) {
@@ -252,34 +558,148 @@ void ActionPadServer::stopServer()
     if (!m_server->isListening())
         return;
 
-    // Disconnect all clients
-    for (auto client : m_clients) {
-        client->disconnectFromHost();
+    // Disconnect network clients, local clients are not served by this socket
+    const auto clients = m_clients;
+    for (auto client : clients) {
+        if (QTcpSocket *socket = qobject_cast<QTcpSocket*>(client)) {
+            m_clients.removeAll(client);
+            m_relayClients.remove(client);
+            m_unidentified.remove(client);
+            socket->disconnectFromHost();
+        }
     }
-    m_clients.clear();
 
     m_server->close();
     emit isRunningChanged();
     emit clientCountChanged();
 }
 
-void ActionPadServer::executeAction(int actionId)
+bool ActionPadServer::startLocalServer()
+{
+    if (m_localServer->isListening())
+        return true;
+
+    const QString name = localSocketName();
+
+    // Only the current user may connect
+    m_localServer->setSocketOptions(QLocalServer::UserAccessOption);
+
+    if (!m_localServer->listen(name)) {
+        if (m_localServer->serverError() != QAbstractSocket::AddressInUseError)
+            return false;
+
+        // A socket left behind by a crashed instance also reports the name as in use,
+        // only remove it when nothing answers on it
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(200))
+            return false;
+
+        QLocalServer::removeServer(name);
+        if (!m_localServer->listen(name))
+            return false;
+    }
+    markAcceptingPresses();
+
+    emit localServerChanged();
+    return true;
+}
+
+QString ActionPadServer::localSocketName() const
+{
+    // Named after the TCP port so instances on different ports do not collide
+    QSettings settings("Odizinne", "ActionPadServer");
+    return settings.value("localServerName", QString("ActionPadServer-%1").arg(m_serverPort)).toString();
+}
+
+void ActionPadServer::markAcceptingPresses()
+{
+    // Recorded when the first listener comes up, whenever that is
+    if (m_acceptingPresses)
+        return;
+
+    m_acceptingPresses = true;
+    StartupTimer::mark("Accepting presses");
+}
+
+void ActionPadServer::stopLocalServer()
+{
+    if (!m_localServer->isListening())
+        return;
+
+    const auto clients = m_clients;
+    for (auto client : clients) {
+        if (QLocalSocket *socket = qobject_cast<QLocalSocket*>(client)) {
+            m_clients.removeAll(client);
+            m_relayClients.remove(client);
+            m_unidentified.remove(client);
+            socket->disconnectFromServer();
+        }
+    }
+
+    m_localServer->close();
+    emit localServerChanged();
+    emit clientCountChanged();
+}
+
+void ActionPadServer::executeAction(int actionId, int relayHops)
 {
+    runAction(actionId, relayHops, nullptr, Completion());
+}
+
+// Runs an action and calls done once it has actually completed. origin is
+// the client that pressed it, if any, and receives the relay tally.
+void ActionPadServer::runAction(int actionId, int relayHops, QIODevice *origin, const Completion &done)
+{
+    TRACE_SCOPE("execute");
     const auto& actions = m_actionModel.getActions();
 
+    // Every press of a known action ends here exactly once
+    const Completion finish = [this, actionId, done](bool success, const QString &output) {
+        emit actionExecuted(actionId, success, output);
+        if (done)
+            done(success, output);
+    };
+
     for (const auto& action : actions) {
         if (action.id == actionId) {
-            QProcess *process = new QProcess(this);
+            if (m_stubExecution) {
+                finish(true, QString());
+                return;
+            }
 
-            connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                    [=, this](int exitCode, QProcess::ExitStatus exitStatus) {
-                        QString output = process->readAllStandardOutput();
-                        bool success = (exitStatus == QProcess::NormalExit && exitCode == 0);
-                        emit actionExecuted(actionId, success, output);
-                        process->deleteLater();
-                    });
+            // Persistent commands are answered by an already running worker
+            if (action.type == 0 && action.persistent) {
+                const quint64 requestId = m_workers.submit(action.id, action.command, action.arguments);
+                if (requestId) {
+                    m_workerPresses.insert(requestId, finish);
+                } else {
+                    finish(false, "Worker unavailable");
+                }
+                return;
+            }
 
             if (action.type == 0) { // Command
+                QProcess *process = new QProcess(this);
+                const qint64 startedNs = Tracer::isEnabled() ? Tracer::now() : 0;
+
+                connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                        [=, this](int exitCode, QProcess::ExitStatus exitStatus) {
+                            Tracer::addSpan("process", startedNs, Tracer::now());
+                            QString output = process->readAllStandardOutput();
+                            bool success = (exitStatus == QProcess::NormalExit && exitCode == 0);
+                            finish(success, output);
+                            process->deleteLater();
+                        });
+                // A program that cannot be started never emits finished
+                connect(process, &QProcess::errorOccurred, this, [=](QProcess::ProcessError error) {
+                    if (error == QProcess::FailedToStart) {
+                        finish(false, process->errorString());
+                        process->deleteLater();
+                    }
+                });
+
+                TRACE_SCOPE("QProcess::start");
                 if (action.arguments.isEmpty()) {
                     process->start(action.command);
                 } else {
@@ -287,20 +707,43 @@ void ActionPadServer::executeAction(int actionId)
                     process->start(action.command, args);
                 }
             } else if (action.type == 1) { // Media Key
-                executeMediaKey(action.mediaKey);
-                process->deleteLater(); // We don't need the process for media keys
+                finish(executeMediaKey(action.mediaKey), QString());
             } else if (action.type == 2) { // Shortcut
-                executeShortcut(action.shortcut);
-                process->deleteLater(); // We don't need the process for shortcuts
+                finish(executeShortcut(action.shortcut), QString());
+            } else if (action.type == 3) { // Relay
+                const quint64 jobId = m_relay.forward(action.id, RelayManager::parseTargets(action.relayTargets),
+                                                      action.relayActionId, relayHops);
+                if (!jobId) {
+                    finish(false, "No relay targets or too many hops");
+                    return;
+                }
+
+                // Peers run the action themselves, only the presser gets their tally
+                QPointer<QIODevice> client(origin);
+                m_relayPresses.insert(jobId, [this, client, actionId, finish](int succeeded, int total, double latencyMs) {
+                    if (client && isClientConnected(client) && !m_relayClients.contains(client)) {
+                        QJsonObject message;
+                        message["type"] = "relay_result";
+                        message["actionId"] = actionId;
+                        message["succeeded"] = succeeded;
+                        message["total"] = total;
+                        message["latencyMs"] = latencyMs;
+                        writeToClient(client, QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+                    }
+                    finish(succeeded == total, QString("%1/%2 targets").arg(succeeded).arg(total));
+                });
             }
 
             return;
         }
     }
+
+    if (done)
+        done(false, "Unknown action");
 }
 
 // Add these new methods to ActionPadServer class
-void ActionPadServer::executeMediaKey(int mediaKeyIndex)
+bool ActionPadServer::executeMediaKey(int mediaKeyIndex)
 {
     BYTE vkCode = 0;
     switch (mediaKeyIndex) {
@@ -312,17 +755,24 @@ void ActionPadServer::executeMediaKey(int mediaKeyIndex)
     case 5: vkCode = VK_VOLUME_DOWN; break;      // Volume Down
     case 6: vkCode = VK_VOLUME_MUTE; break;      // Volume Mute
     }
-    if (vkCode) {
-        keybd_event(vkCode, 0, KEYEVENTF_EXTENDEDKEY, 0);
-        keybd_event(vkCode, 0, KEYEVENTF_EXTENDEDKEY | KEYEVENTF_KEYUP, 0);
-    }
+    if (!vkCode)
+        return false;
+
+    InjectionRequest request;
+    request.keys[0] = vkCode;
+    request.keyCount = 1;
+    request.extended = true;
+    return m_injector.enqueue(request);
 }
 
-void ActionPadServer::executeShortcut(const QString &shortcut)
+bool ActionPadServer::executeShortcut(const QString &shortcut)
 {
+    TRACE_SCOPE("executeShortcut");
     QStringList parts = shortcut.split('+', Qt::SkipEmptyParts);
 
-    QList<WORD> keysToPress;
+    InjectionRequest request;
+    // Small delay between press and release to ensure keys are registered
+    request.holdMicroseconds = 10000;
 
     for (const QString &part : parts) {
         QString key = part.trimmed();
@@ -406,46 +856,85 @@ void ActionPadServer::executeShortcut(const QString &shortcut)
             }
         }
 
-        if (vkCode != 0) {
-            keysToPress.append(vkCode);
+        if (vkCode != 0 && request.keyCount < InjectionRequest::MaxKeys) {
+            request.keys[request.keyCount++] = vkCode;
         }
     }
 
-    // Press all keys down in order
-    for (WORD vk : keysToPress) {
-        keybd_event(vk, 0, 0, 0);
-    }
-
-    // Small delay to ensure keys are registered
-    Sleep(10);
+    if (request.keyCount == 0)
+        return false;
 
-    // Release all keys in reverse order
-    for (int i = keysToPress.size() - 1; i >= 0; --i) {
-        keybd_event(keysToPress[i], 0, KEYEVENTF_KEYUP, 0);
-    }
+    return m_injector.enqueue(request);
 }
 
 void ActionPadServer::onNewConnection()
 {
+    TRACE_SCOPE("connect");
     QTcpSocket *client = m_server->nextPendingConnection();
+    connect(client, &QTcpSocket::disconnected, this, &ActionPadServer::onClientDisconnected);
+    addClient(client, client->peerAddress().toString());
+}
+
+void ActionPadServer::onNewLocalConnection()
+{
+    TRACE_SCOPE("connect");
+    QLocalSocket *client = m_localServer->nextPendingConnection();
+    connect(client, &QLocalSocket::disconnected, this, &ActionPadServer::onClientDisconnected);
+    addClient(client, clientAddress(client));
+}
+
+void ActionPadServer::addClient(QIODevice *client, const QString &address)
+{
     m_clients.append(client);
+    m_recorder.record(TraceRecord::Connected, client);
 
-    connect(client, &QTcpSocket::disconnected, this, &ActionPadServer::onClientDisconnected);
-    connect(client, &QTcpSocket::readyRead, this, &ActionPadServer::onClientDataReceived);
+    connect(client, &QIODevice::readyRead, this, &ActionPadServer::onClientDataReceived);
 
-    emit clientConnected(client->peerAddress().toString());
+    emit clientConnected(address);
     emit clientCountChanged();
 
-    // Send current actions to the new client
-    sendActionsToClient(client);
+    // Send current actions once the client has said what it is, relays do not
+    // want them. Pads that never send anything get them after a short wait.
+    m_unidentified.insert(client);
+    QTimer::singleShot(IdentifyTimeoutMs, client, [this, client]() {
+        identifyClient(client);
+    });
+}
+
+void ActionPadServer::identifyClient(QIODevice *client)
+{
+    if (!m_unidentified.remove(client))
+        return;
+
+    if (isClientConnected(client))
+        sendActionsToClient(client);
+}
+
+bool ActionPadServer::isClientConnected(QIODevice *client)
+{
+    if (QTcpSocket *socket = qobject_cast<QTcpSocket*>(client))
+        return socket->state() == QAbstractSocket::ConnectedState;
+    if (QLocalSocket *socket = qobject_cast<QLocalSocket*>(client))
+        return socket->state() == QLocalSocket::ConnectedState;
+    return false;
+}
+
+QString ActionPadServer::clientAddress(QIODevice *client)
+{
+    if (QTcpSocket *socket = qobject_cast<QTcpSocket*>(client))
+        return socket->peerAddress().toString();
+    return "local";
 }
 
 void ActionPadServer::onClientDisconnected()
 {
-    QTcpSocket *client = qobject_cast<QTcpSocket*>(sender());
+    QIODevice *client = qobject_cast<QIODevice*>(sender());
     if (client) {
-        emit clientDisconnected(client->peerAddress().toString());
+        emit clientDisconnected(clientAddress(client));
         m_clients.removeAll(client);
+        m_relayClients.remove(client);
+        m_unidentified.remove(client);
+        m_recorder.record(TraceRecord::Disconnected, client);
         emit clientCountChanged();
         client->deleteLater();
     }
@@ -453,28 +942,65 @@ void ActionPadServer::onClientDisconnected()
 
 void ActionPadServer::onClientDataReceived()
 {
-    QTcpSocket *client = qobject_cast<QTcpSocket*>(sender());
+    QIODevice *client = qobject_cast<QIODevice*>(sender());
     if (!client) return;
 
-    QByteArray data = client->readAll();
-    QJsonDocument doc = QJsonDocument::fromJson(data);
+    TRACE_SCOPE("receive");
 
-    if (doc.isObject()) {
-        processClientMessage(client, doc.object());
+    // Messages are newline delimited, several may arrive in one read
+    while (client->canReadLine()) {
+        QByteArray line = client->readLine();
+        m_inboundRecord = m_recorder.record(TraceRecord::Inbound, client, line);
+        QJsonDocument doc = QJsonDocument::fromJson(line);
+        if (doc.isObject()) {
+            processClientMessage(client, doc.object());
+        }
+    }
+
+    // Older clients send a single message without a trailing newline
+    if (client->bytesAvailable() > 0) {
+        // Do not buffer without limit for a client that never sends a newline
+        if (client->bytesAvailable() > MaxUnterminatedBytes) {
+            client->close();
+            return;
+        }
+
+        // Only try to parse once the data can be a complete object
+        QByteArray data = client->peek(client->bytesAvailable());
+        if (!data.trimmed().endsWith('}'))
+            return;
+
+        // A nested object can also end a chunk, wait for the rest of it
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+        if (error.error == QJsonParseError::UnterminatedObject
+            || error.error == QJsonParseError::UnterminatedArray
+            || error.error == QJsonParseError::UnterminatedString)
+            return;
+
+        // Consume the data even when it does not parse, left in the buffer it
+        // would be glued onto the front of the next message
+        client->skip(data.size());
+        m_inboundRecord = m_recorder.record(TraceRecord::Inbound, client, data);
+        if (doc.isObject()) {
+            processClientMessage(client, doc.object());
+        }
     }
 }
 
 void ActionPadServer::broadcastActionsUpdate()
 {
     for (auto client : m_clients) {
-        if (client && client->state() == QTcpSocket::ConnectedState) {
+        if (client && isClientConnected(client) && !m_relayClients.contains(client)
+            && !m_unidentified.contains(client)) {
             sendActionsToClient(client);
         }
     }
 }
 
-void ActionPadServer::sendActionsToClient(QTcpSocket *client)
+void ActionPadServer::sendActionsToClient(QIODevice *client)
 {
+    TRACE_SCOPE("serializeActions");
     QJsonObject message;
     message["type"] = "actions";
     QJsonArray actionsArray;
@@ -484,66 +1010,250 @@ void ActionPadServer::sendActionsToClient(QTcpSocket *client)
         QJsonObject actionObj;
         actionObj["id"] = action.id;
         actionObj["name"] = action.name;
-        QString iconData = "placeholder";
+        actionObj["icon"] = iconData(action.icon);
+        actionsArray.append(actionObj);
+    }
 
-        if (!action.icon.isEmpty() && action.icon != "placeholder") {
-            if (action.icon.startsWith("qrc:/")) {
-                iconData = action.icon;
-            } else {
-                QUrl iconUrl(action.icon);
-                QString filePath = iconUrl.toLocalFile();
+    message["actions"] = actionsArray;
+    QJsonDocument doc(message);
+    writeToClient(client, doc.toJson(QJsonDocument::Compact) + "\n");
+}
 
-                if (filePath.isEmpty()) {
-                    filePath = action.icon;
-                }
+QString ActionPadServer::iconData(const QString &icon)
+{
+    if (icon.isEmpty() || icon == "placeholder")
+        return "placeholder";
 
-                // Check file size first, before reading
-                QFileInfo fileInfo(filePath);
-                if (fileInfo.exists() && fileInfo.size() <= 200000) { // 200KB limit
-                    QFile iconFile(filePath);
-                    if (iconFile.open(QIODevice::ReadOnly)) {
-                        QByteArray imageData = iconFile.readAll();
-                        QString base64 = imageData.toBase64();
-
-                        QString mimeType = "image/png";
-                        if (filePath.endsWith(".jpg", Qt::CaseInsensitive) ||
-                            filePath.endsWith(".jpeg", Qt::CaseInsensitive)) {
-                            mimeType = "image/jpeg";
-                        } else if (filePath.endsWith(".svg", Qt::CaseInsensitive)) {
-                            mimeType = "image/svg+xml";
-                        } else if (filePath.endsWith(".gif", Qt::CaseInsensitive)) {
-                            mimeType = "image/gif";
-                        } else if (filePath.endsWith(".ico", Qt::CaseInsensitive)) {
-                            mimeType = "image/x-icon";
-                        }
-
-                        iconData = QString("data:%1;base64,%2").arg(mimeType, base64);
-                    }
-                }
-                // If file doesn't exist, is too large, or fails to open -> iconData stays "placeholder"
-            }
-        }
+    if (icon.startsWith("qrc:/"))
+        return icon;
 
-        actionObj["icon"] = iconData;
-        actionsArray.append(actionObj);
+    QUrl iconUrl(icon);
+    QString filePath = iconUrl.toLocalFile();
+
+    if (filePath.isEmpty()) {
+        filePath = icon;
     }
 
-    message["actions"] = actionsArray;
-    QJsonDocument doc(message);
-    client->write(doc.toJson(QJsonDocument::Compact) + "\n");
+    // Check file size first, before reading
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists() || fileInfo.size() > 200000) // 200KB limit
+        return "placeholder";
+
+    // Icons are read and encoded once, every connect reuses them until the file changes
+    const QDateTime modified = fileInfo.lastModified();
+    const auto cached = m_iconCache.constFind(icon);
+    if (cached != m_iconCache.constEnd() && cached->modified == modified && cached->size == fileInfo.size())
+        return cached->data;
+
+    TRACE_SCOPE("readIcon");
+    QFile iconFile(filePath);
+    if (!iconFile.open(QIODevice::ReadOnly))
+        return "placeholder";
+
+    QByteArray imageData = iconFile.readAll();
+    QString base64 = imageData.toBase64();
+
+    QString mimeType = "image/png";
+    if (filePath.endsWith(".jpg", Qt::CaseInsensitive) ||
+        filePath.endsWith(".jpeg", Qt::CaseInsensitive)) {
+        mimeType = "image/jpeg";
+    } else if (filePath.endsWith(".svg", Qt::CaseInsensitive)) {
+        mimeType = "image/svg+xml";
+    } else if (filePath.endsWith(".gif", Qt::CaseInsensitive)) {
+        mimeType = "image/gif";
+    } else if (filePath.endsWith(".ico", Qt::CaseInsensitive)) {
+        mimeType = "image/x-icon";
+    }
+
+    CachedIcon entry;
+    entry.modified = modified;
+    entry.size = fileInfo.size();
+    entry.data = QString("data:%1;base64,%2").arg(mimeType, base64);
+    m_iconCache.insert(icon, entry);
+    return entry.data;
 }
 
-void ActionPadServer::processClientMessage(QTcpSocket *client, const QJsonObject &message)
+void ActionPadServer::writeToClient(QIODevice *client, const QByteArray &frame)
 {
+    TRACE_SCOPE("write");
+    m_recorder.record(TraceRecord::Outbound, client, frame);
+    client->write(frame);
+}
+
+void ActionPadServer::processClientMessage(QIODevice *client, const QJsonObject &message)
+{
+    TRACE_SCOPE("dispatch");
     QString type = message["type"].toString();
 
+    // The first message identifies the connection, anything but a relay
+    // hello makes it a pad. get_actions sends the list itself.
+    if (type != "relay_hello") {
+        if (type == "get_actions")
+            m_unidentified.remove(client);
+        else
+            identifyClient(client);
+    }
+
     if (type == "action_press") {
         int actionId = message["actionId"].toInt();
-        executeAction(actionId);
+
+        // Recordings note when every press completes, tagged presses are
+        // also answered then
+        QPointer<QIODevice> origin(client);
+        const quint64 inboundRecord = m_inboundRecord;
+        const bool tagged = message.contains("requestId");
+        const QJsonValue requestId = message["requestId"];
+        Completion acknowledge = [this, origin, inboundRecord, tagged, requestId, actionId]
+                                 (bool success, const QString &output) {
+            m_recorder.recordCompletion(inboundRecord, success);
+            if (!tagged || !origin || !isClientConnected(origin))
+                return;
+
+            QJsonObject reply;
+            reply["type"] = "action_result";
+            reply["requestId"] = requestId;
+            reply["actionId"] = actionId;
+            reply["success"] = success;
+            if (!output.isEmpty())
+                reply["output"] = output;
+            writeToClient(origin, QJsonDocument(reply).toJson(QJsonDocument::Compact) + "\n");
+        };
+
+        runAction(actionId, message["relayHops"].toInt(0), client, acknowledge);
+    }
+    else if (type == "relay_hello") {
+        // Only as the first message, and with the shared key when one is set
+        QSettings settings("Odizinne", "ActionPadServer");
+        const QString key = settings.value("relayKey").toString();
+        if (m_unidentified.remove(client) && (key.isEmpty() || message["key"].toString() == key)) {
+            m_relayClients.insert(client);
+            emit clientCountChanged();
+        } else {
+            QJsonObject reply;
+            reply["type"] = "error";
+            reply["request"] = type;
+            reply["message"] = "Relay not accepted";
+            writeToClient(client, QJsonDocument(reply).toJson(QJsonDocument::Compact) + "\n");
+            identifyClient(client);
+        }
     }
     else if (type == "get_actions") {
         sendActionsToClient(client);
     }
+    else if (type == "get_metrics") {
+        QJsonObject reply;
+        reply["type"] = "metrics";
+        reply["injection"] = QJsonObject::fromVariantMap(m_injector.metrics());
+        reply["relay"] = QJsonObject::fromVariantMap(m_relay.metrics());
+        reply["workers"] = QJsonObject::fromVariantMap(m_workers.metrics());
+        reply["startup"] = StartupTimer::report();
+        writeToClient(client, QJsonDocument(reply).toJson(QJsonDocument::Compact) + "\n");
+    }
+    else if ((type == "import_actions" || type == "export_actions" || type == "batch")
+             && !canEditLayout(client)) {
+        QJsonObject reply;
+        reply["type"] = "error";
+        reply["request"] = type;
+        reply["message"] = "Layout editing is only allowed from the local socket";
+        writeToClient(client, QJsonDocument(reply).toJson(QJsonDocument::Compact) + "\n");
+    }
+    else if (type == "import_actions") {
+        int imported = m_actionModel.importActions(message["actions"].toArray(),
+                                                   message["replace"].toBool(false));
+        QJsonObject reply;
+        reply["type"] = "import_result";
+        reply["imported"] = imported;
+        writeToClient(client, QJsonDocument(reply).toJson(QJsonDocument::Compact) + "\n");
+    }
+    else if (type == "export_actions") {
+        QJsonObject reply;
+        reply["type"] = "actions_export";
+        reply["actions"] = m_actionModel.exportActions();
+        writeToClient(client, QJsonDocument(reply).toJson(QJsonDocument::Compact) + "\n");
+    }
+    else if (type == "batch") {
+        int applied = m_actionModel.applyOperations(message["operations"].toArray());
+        QJsonObject reply;
+        reply["type"] = "batch_result";
+        reply["applied"] = applied;
+        writeToClient(client, QJsonDocument(reply).toJson(QJsonDocument::Compact) + "\n");
+    }
+}
+
+bool ActionPadServer::canEditLayout(QIODevice *client) const
+{
+    // Network clients could otherwise create and run arbitrary commands
+    if (qobject_cast<QLocalSocket*>(client))
+        return true;
+
+    QSettings settings("Odizinne", "ActionPadServer");
+    return settings.value("allowRemoteLayoutEdits", false).toBool();
+}
+
+void ActionPadServer::onWorkerRequestFinished(quint64 requestId, int actionId, bool success, const QString &output)
+{
+    Q_UNUSED(actionId);
+    const Completion done = m_workerPresses.take(requestId);
+    if (done)
+        done(success, output);
+}
+
+void ActionPadServer::onRelayCompleted(quint64 jobId, int actionId, int succeeded, int total, double latencyMs)
+{
+    Q_UNUSED(actionId);
+    const RelayCompletion done = m_relayPresses.take(jobId);
+    if (done)
+        done(succeeded, total, latencyMs);
+}
+
+bool ActionPadServer::startRecording(const QString &filePath)
+{
+    QString localPath = QUrl(filePath).toLocalFile();
+    if (localPath.isEmpty())
+        localPath = filePath;
+
+    bool started = m_recorder.start(localPath);
+    emit isRecordingChanged();
+    return started;
+}
+
+void ActionPadServer::stopRecording()
+{
+    m_recorder.stop();
+    emit isRecordingChanged();
+}
+
+QJsonArray ActionPadServer::startupReport() const
+{
+    return StartupTimer::report();
+}
+
+bool ActionPadServer::tracingEnabled() const
+{
+    return Tracer::isEnabled();
+}
+
+void ActionPadServer::setTracingEnabled(bool enable)
+{
+    if (Tracer::isEnabled() == enable)
+        return;
+
+    if (enable) {
+        QSettings settings("Odizinne", "ActionPadServer");
+        Tracer::setStallThreshold(settings.value("stallThresholdMs", 100).toInt());
+    }
+
+    Tracer::setEnabled(enable);
+    emit tracingEnabledChanged();
+}
+
+bool ActionPadServer::saveTrace(const QString &filePath)
+{
+    QString localPath = QUrl(filePath).toLocalFile();
+    if (localPath.isEmpty())
+        localPath = filePath;
+
+    return Tracer::dump(localPath);
 }
 
 void ActionPadServer::setWindowVisible(bool visible)
@@ -0,0 +1,77 @@
+#include "iconprovider.h"
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QUrl>
+
+IconProvider::IconProvider()
+    : QQuickImageProvider(QQuickImageProvider::Image,
+                          QQmlImageProviderBase::ForceAsynchronousImageLoading)
+{
+    // Cost is counted in kilobytes, 48x48 ARGB thumbnails are ~9KB each
+    m_cache.setMaxCost(64 * 1024);
+}
+
+QString IconProvider::resolvePath(const QString &icon)
+{
+    if (icon.startsWith("qrc:/"))
+        return icon.mid(3);
+
+    QString filePath = QUrl(icon).toLocalFile();
+    if (filePath.isEmpty())
+        filePath = icon;
+    return filePath;
+}
+
+QImage IconProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    // Main.qml percent-encodes the icon with '$' in place of '%', which the
+    // image URL handling leaves alone, so the path is decoded exactly once here
+    QString encoded = id;
+    encoded.replace('$', '%');
+    const QString filePath = resolvePath(QUrl::fromPercentEncoding(encoded.toUtf8()));
+    const QFileInfo fileInfo(filePath);
+
+    // Include the modification time so an edited icon file is decoded again
+    const QString key = QString("%1|%2x%3|%4")
+                            .arg(filePath)
+                            .arg(requestedSize.width())
+                            .arg(requestedSize.height())
+                            .arg(fileInfo.lastModified().toMSecsSinceEpoch());
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (QImage *cached = m_cache.object(key)) {
+            if (size)
+                *size = cached->size();
+            return *cached;
+        }
+    }
+
+    QImageReader reader(filePath);
+    reader.setAutoTransform(true);
+
+    // Let the decoder scale down while reading instead of decoding full size
+    if (requestedSize.isValid() && !requestedSize.isEmpty()) {
+        QSize sourceSize = reader.size();
+        if (sourceSize.isValid())
+            sourceSize.scale(requestedSize, Qt::KeepAspectRatio);
+        else
+            sourceSize = requestedSize;
+        reader.setScaledSize(sourceSize);
+    }
+
+    QImage image = reader.read();
+    if (image.isNull())
+        return image;
+
+    if (size)
+        *size = image.size();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cache.insert(key, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+    }
+
+    return image;
+}
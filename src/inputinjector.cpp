@@ -0,0 +1,137 @@
+#include "inputinjector.h"
+#include "tracer.h"
+#include <windows.h>
+
+InputInjector::InputInjector(QObject *parent)
+    : QThread(parent)
+{
+    setObjectName("InputInjector");
+    m_clock.start();
+}
+
+InputInjector::~InputInjector()
+{
+    stop();
+}
+
+bool InputInjector::enqueue(InjectionRequest request)
+{
+    if (request.keyCount <= 0)
+        return false;
+
+    request.keyCount = qMin(request.keyCount, static_cast<int>(InjectionRequest::MaxKeys));
+    request.enqueuedAtNs = m_clock.nsecsElapsed();
+
+    // Never block the GUI thread, a full queue means the press is dropped
+    if (!m_queue.push(request)) {
+        m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_wakeups.fetch_add(1, std::memory_order_release);
+    m_wakeups.notify_one();
+    return true;
+}
+
+void InputInjector::stop()
+{
+    if (!isRunning())
+        return;
+
+    m_running.store(false, std::memory_order_release);
+    m_wakeups.fetch_add(1, std::memory_order_release);
+    m_wakeups.notify_one();
+    wait();
+}
+
+QVariantMap InputInjector::metrics() const
+{
+    const quint64 count = m_injectedCount.load(std::memory_order_relaxed);
+    const qint64 total = m_totalLatencyNs.load(std::memory_order_relaxed);
+
+    QVariantMap result;
+    result["injected"] = count;
+    result["dropped"] = m_droppedCount.load(std::memory_order_relaxed);
+    result["lastLatencyUs"] = m_lastLatencyNs.load(std::memory_order_relaxed) / 1000.0;
+    result["maxLatencyUs"] = m_maxLatencyNs.load(std::memory_order_relaxed) / 1000.0;
+    result["avgLatencyUs"] = count ? (total / static_cast<double>(count)) / 1000.0 : 0.0;
+    return result;
+}
+
+void InputInjector::run()
+{
+    while (true) {
+        // Read the wakeup counter before draining so a push racing with the
+        // drain changes it and the wait below returns immediately
+        const quint32 seen = m_wakeups.load(std::memory_order_acquire);
+
+        InjectionRequest request;
+        while (m_queue.pop(request)) {
+            inject(request);
+        }
+
+        if (!m_running.load(std::memory_order_acquire))
+            break;
+
+        m_wakeups.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void InputInjector::inject(const InjectionRequest &request)
+{
+    TRACE_SCOPE("inject");
+    const qint64 latency = m_clock.nsecsElapsed() - request.enqueuedAtNs;
+    m_lastLatencyNs.store(latency, std::memory_order_relaxed);
+    m_totalLatencyNs.fetch_add(latency, std::memory_order_relaxed);
+    if (latency > m_maxLatencyNs.load(std::memory_order_relaxed))
+        m_maxLatencyNs.store(latency, std::memory_order_relaxed);
+    m_injectedCount.fetch_add(1, std::memory_order_relaxed);
+
+    const DWORD baseFlags = request.extended ? KEYEVENTF_EXTENDEDKEY : 0;
+    INPUT inputs[InjectionRequest::MaxKeys] = {};
+
+    // Press all keys down in order
+    for (int i = 0; i < request.keyCount; ++i) {
+        inputs[i].type = INPUT_KEYBOARD;
+        inputs[i].ki.wVk = request.keys[i];
+        inputs[i].ki.dwFlags = baseFlags;
+    }
+    SendInput(request.keyCount, inputs, sizeof(INPUT));
+
+    if (request.holdMicroseconds > 0)
+        waitUntil(m_clock.nsecsElapsed() + qint64(request.holdMicroseconds) * 1000);
+
+    // Release all keys in reverse order
+    for (int i = 0; i < request.keyCount; ++i) {
+        inputs[i].type = INPUT_KEYBOARD;
+        inputs[i].ki.wVk = request.keys[request.keyCount - 1 - i];
+        inputs[i].ki.dwFlags = baseFlags | KEYEVENTF_KEYUP;
+    }
+    SendInput(request.keyCount, inputs, sizeof(INPUT));
+}
+
+void InputInjector::waitUntil(qint64 deadlineNs) const
+{
+    // Sleep through most of the interval, then yield until the deadline.
+    // The system timer resolution is raised to ~1ms only while sleeping here,
+    // keeping it raised while idle costs power system wide
+    bool raised = false;
+    while (true) {
+        const qint64 remaining = deadlineNs - m_clock.nsecsElapsed();
+        if (remaining <= 0)
+            break;
+
+        if (remaining > 2000000) {
+            if (!raised) {
+                timeBeginPeriod(1);
+                raised = true;
+            }
+            QThread::usleep((remaining - 1500000) / 1000);
+        } else {
+            QThread::yieldCurrentThread();
+        }
+    }
+
+    if (raised)
+        timeEndPeriod(1);
+}
@@ -1,20 +1,73 @@
 #include <QApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QCommandLineParser>
+#include "actionpadserver.h"
+#include "iconprovider.h"
+#include "startuptimer.h"
+#include <QQuickWindow>
+#include <QTimer>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
+    StartupTimer::start();
     qputenv("QT_QUICK_CONTROLS_MATERIAL_VARIANT", "Dense");
     QApplication app(argc, argv);
     app.setOrganizationName("Odizinne");
     app.setApplicationName("ActionPadServer");
     app.setQuitOnLastWindowClosed(false);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption recordOption("record-traffic",
+                                    "Append client traffic to a binary trace <file>.", "file");
+    QCommandLineOption stubOption("stub-execution",
+                                  "Report actions as executed without running them (trace replays).");
+    parser.addOption(recordOption);
+    parser.addOption(stubOption);
+    parser.process(app);
+    StartupTimer::mark("Application created");
+
+    ActionPadServer *server = ActionPadServer::instance();
+    server->setStubExecution(parser.isSet(stubOption));
+    if (parser.isSet(recordOption)) {
+        server->startRecording(parser.value(recordOption));
+    }
+
     QQmlApplicationEngine engine;
-    engine.loadFromModule("Odizinne.ActionPadServer", "Main");
+    engine.addImageProvider("actionicon", new IconProvider);
+
+    auto loadInterface = [&engine]() {
+        engine.loadFromModule("Odizinne.ActionPadServer", "Main");
+        if (engine.rootObjects().isEmpty())
+            return false;
+        StartupTimer::mark("Interface loaded");
+        return true;
+    };
+
+    if (server->windowVisible()) {
+        if (!loadInterface())
+            return -1;
+    } else {
+        // Tray only startup: load the interface the first time it is shown.
+        // Main's own showWindow handler is connected during this emission
+        // and is not called for it, so show the window here.
+        QObject::connect(server, &ActionPadServer::showWindow, &engine, [&engine, loadInterface]() {
+            if (!engine.rootObjects().isEmpty())
+                return;
+            // Presses are still served from the tray, report the failure and
+            // try again the next time the window is asked for
+            if (!loadInterface()) {
+                qWarning() << "Unable to load the interface";
+                return;
+            }
+            if (auto window = qobject_cast<QQuickWindow*>(engine.rootObjects().value(0)))
+                window->show();
+        });
+    }
 
-    if (engine.rootObjects().isEmpty())
-        return -1;
+    QTimer::singleShot(0, &app, []() { StartupTimer::mark("Event loop running"); });
 
     return app.exec();
 }
@@ -0,0 +1,294 @@
+#include "relaymanager.h"
+#include "tracer.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+
+namespace {
+constexpr int InitialBackoffMs = 250;
+constexpr int MaxBackoffMs = 30000;
+constexpr int JobTimeoutMs = 3000;
+constexpr int MaxPendingPerPeer = 64;
+}
+
+RelayManager::RelayManager(QObject *parent)
+    : QObject(parent)
+{
+}
+
+RelayManager::~RelayManager()
+{
+    qDeleteAll(m_peers);
+}
+
+QStringList RelayManager::parseTargets(const QString &targets)
+{
+    static const QRegularExpression separators("[,;\\s]+");
+    return targets.split(separators, Qt::SkipEmptyParts);
+}
+
+// Returns the job id later passed to relayCompleted, or 0 when there is
+// nothing to forward or the press has already made too many hops
+quint64 RelayManager::forward(int actionId, const QStringList &targets, int remoteActionId, int hops)
+{
+    TRACE_SCOPE("relayForward");
+    if (targets.isEmpty() || hops >= MaxHops)
+        return 0;
+
+    const quint64 jobId = m_nextJobId++;
+    Job &job = m_jobs[jobId];
+    job.actionId = actionId;
+    job.total = targets.size();
+    job.dispatching = true;
+    job.timer.start();
+
+    // Targets that never answer are counted as failed once the job times out
+    job.timeout = new QTimer(this);
+    job.timeout->setSingleShot(true);
+    connect(job.timeout, &QTimer::timeout, this, [this, jobId]() {
+        finishJob(jobId);
+    });
+    job.timeout->start(JobTimeoutMs);
+
+    for (const QString &target : targets) {
+        const quint64 requestId = m_nextRequestId++;
+        m_requestJobs.insert(requestId, jobId);
+
+        Peer *peer = peerFor(target);
+        if (!peer) {
+            finishRequest(requestId, false);
+            continue;
+        }
+
+        QJsonObject message;
+        message["type"] = "action_press";
+        message["actionId"] = remoteActionId > 0 ? remoteActionId : actionId;
+        message["requestId"] = QString::number(requestId);
+        message["relayHops"] = hops + 1;
+        QByteArray frame = QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n";
+
+        if (peer->socket->state() == QAbstractSocket::ConnectedState) {
+            peer->inFlight.insert(requestId);
+            peer->socket->write(frame);
+        } else if (peer->pending.size() < MaxPendingPerPeer) {
+            peer->pending.append(qMakePair(requestId, frame));
+        } else {
+            finishRequest(requestId, false);
+        }
+    }
+
+    // Targets rejected above may already have settled the job, report it
+    // once the caller knows the job id
+    auto it = m_jobs.find(jobId);
+    it->dispatching = false;
+    if (it->finished >= it->total) {
+        QTimer::singleShot(0, this, [this, jobId]() {
+            finishJob(jobId);
+        });
+    }
+
+    return jobId;
+}
+
+void RelayManager::retainOnly(const QSet<QString> &targets)
+{
+    for (auto it = m_peers.begin(); it != m_peers.end();) {
+        if (targets.contains(it.key())) {
+            ++it;
+        } else {
+            retire(it.value());
+            it = m_peers.erase(it);
+        }
+    }
+}
+
+void RelayManager::retire(Peer *peer)
+{
+    // Stop reconnecting before the socket is closed
+    peer->socket->disconnect(this);
+    peer->reconnectTimer->stop();
+    peer->socket->abort();
+
+    QList<quint64> lost = peer->inFlight.values();
+    for (const auto &entry : std::as_const(peer->pending)) {
+        lost.append(entry.first);
+    }
+    peer->inFlight.clear();
+    peer->pending.clear();
+    for (quint64 requestId : std::as_const(lost)) {
+        finishRequest(requestId, false);
+    }
+
+    peer->socket->deleteLater();
+    peer->reconnectTimer->deleteLater();
+    delete peer;
+}
+
+RelayManager::Peer *RelayManager::peerFor(const QString &target)
+{
+    if (Peer *peer = m_peers.value(target))
+        return peer;
+
+    QString host = target;
+    quint16 port = 8080;
+    const int colon = target.lastIndexOf(':');
+    if (colon > 0) {
+        bool ok;
+        port = target.mid(colon + 1).toUShort(&ok);
+        if (!ok || port == 0)
+            return nullptr;
+        host = target.left(colon);
+    }
+
+    Peer *peer = new Peer;
+    peer->host = host;
+    peer->port = port;
+    peer->backoffMs = InitialBackoffMs;
+    peer->socket = new QTcpSocket(this);
+    peer->socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    peer->socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+    peer->reconnectTimer = new QTimer(this);
+    peer->reconnectTimer->setSingleShot(true);
+
+    connect(peer->socket, &QTcpSocket::connected, this, [this, peer]() { onPeerConnected(peer); });
+    // Watch the state rather than disconnected, a refused connection never emits it
+    connect(peer->socket, &QTcpSocket::stateChanged, this, [this, peer](QAbstractSocket::SocketState state) {
+        if (state == QAbstractSocket::UnconnectedState)
+            onPeerDisconnected(peer);
+    });
+    connect(peer->socket, &QTcpSocket::readyRead, this, [this, peer]() { onPeerReadyRead(peer); });
+    connect(peer->reconnectTimer, &QTimer::timeout, this, [this, peer]() { connectPeer(peer); });
+
+    m_peers.insert(target, peer);
+    connectPeer(peer);
+    return peer;
+}
+
+void RelayManager::connectPeer(Peer *peer)
+{
+    if (peer->socket->state() != QAbstractSocket::UnconnectedState)
+        return;
+
+    peer->socket->connectToHost(peer->host, peer->port);
+}
+
+void RelayManager::onPeerConnected(Peer *peer)
+{
+    peer->backoffMs = InitialBackoffMs;
+
+    // Tell the peer this is a relay so it skips action list broadcasts
+    QJsonObject hello;
+    hello["type"] = "relay_hello";
+    if (!m_key.isEmpty())
+        hello["key"] = m_key;
+    peer->socket->write(QJsonDocument(hello).toJson(QJsonDocument::Compact) + "\n");
+
+    for (const auto &entry : std::as_const(peer->pending)) {
+        peer->inFlight.insert(entry.first);
+        peer->socket->write(entry.second);
+    }
+    peer->pending.clear();
+}
+
+void RelayManager::onPeerDisconnected(Peer *peer)
+{
+    // Presses already written are lost with the connection
+    const QSet<quint64> lost = peer->inFlight;
+    peer->inFlight.clear();
+    for (quint64 requestId : lost) {
+        finishRequest(requestId, false);
+    }
+
+    if (!peer->reconnectTimer->isActive()) {
+        peer->reconnectTimer->start(peer->backoffMs);
+        peer->backoffMs = qMin(peer->backoffMs * 2, MaxBackoffMs);
+    }
+}
+
+void RelayManager::onPeerReadyRead(Peer *peer)
+{
+    while (peer->socket->canReadLine()) {
+        const QJsonDocument doc = QJsonDocument::fromJson(peer->socket->readLine());
+        if (!doc.isObject())
+            continue;
+
+        const QJsonObject message = doc.object();
+        if (message["type"].toString() != "action_result")
+            continue;
+
+        const quint64 requestId = message["requestId"].toString().toULongLong();
+        if (peer->inFlight.remove(requestId))
+            finishRequest(requestId, message["success"].toBool());
+    }
+}
+
+void RelayManager::finishRequest(quint64 requestId, bool success)
+{
+    const auto it = m_requestJobs.constFind(requestId);
+    if (it == m_requestJobs.constEnd())
+        return;
+
+    const quint64 jobId = it.value();
+    m_requestJobs.erase(it);
+
+    auto jobIt = m_jobs.find(jobId);
+    if (jobIt == m_jobs.end())
+        return;
+
+    ++jobIt->finished;
+    if (success)
+        ++jobIt->succeeded;
+
+    if (jobIt->finished >= jobIt->total && !jobIt->dispatching)
+        finishJob(jobId);
+}
+
+void RelayManager::finishJob(quint64 jobId)
+{
+    auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end())
+        return;
+
+    const Job job = it.value();
+    m_jobs.erase(it);
+    job.timeout->deleteLater();
+
+    // Drop requests still outstanding, their answers are no longer wanted
+    for (auto reqIt = m_requestJobs.begin(); reqIt != m_requestJobs.end();) {
+        if (reqIt.value() == jobId) {
+            for (Peer *peer : std::as_const(m_peers)) {
+                peer->inFlight.remove(reqIt.key());
+                peer->pending.removeIf([&](const auto &entry) { return entry.first == reqIt.key(); });
+            }
+            reqIt = m_requestJobs.erase(reqIt);
+        } else {
+            ++reqIt;
+        }
+    }
+
+    const double latencyMs = job.timer.nsecsElapsed() / 1e6;
+    ++m_completedJobs;
+    m_lastLatencyMs = latencyMs;
+    m_totalLatencyMs += latencyMs;
+    m_maxLatencyMs = qMax(m_maxLatencyMs, latencyMs);
+
+    emit relayCompleted(jobId, job.actionId, job.succeeded, job.total, latencyMs);
+}
+
+QVariantMap RelayManager::metrics() const
+{
+    int connected = 0;
+    for (const Peer *peer : m_peers) {
+        if (peer->socket->state() == QAbstractSocket::ConnectedState)
+            ++connected;
+    }
+
+    QVariantMap result;
+    result["peers"] = m_peers.size();
+    result["connectedPeers"] = connected;
+    result["completed"] = m_completedJobs;
+    result["lastLatencyMs"] = m_lastLatencyMs;
+    result["maxLatencyMs"] = m_maxLatencyMs;
+    result["avgLatencyMs"] = m_completedJobs ? m_totalLatencyMs / m_completedJobs : 0.0;
+    return result;
+}
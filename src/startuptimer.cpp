@@ -0,0 +1,61 @@
+#include "startuptimer.h"
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+#include <windows.h>
+
+namespace StartupTimer {
+
+namespace {
+QElapsedTimer timer;
+qint64 processAgeUs = 0;                // Process age when start() was called
+QList<QPair<QString, qint64>> stages;   // Stage name, microseconds since process creation
+
+qint64 fileTimeUs(const FILETIME &time)
+{
+    return qint64((quint64(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+}
+}
+
+void start()
+{
+    timer.start();
+    stages.clear();
+
+    // Loader and static initialization run before main(), count them too
+    processAgeUs = 0;
+    FILETIME creation, exited, kernel, user, now;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exited, &kernel, &user)) {
+        GetSystemTimePreciseAsFileTime(&now);
+        processAgeUs = qMax<qint64>(0, fileTimeUs(now) - fileTimeUs(creation));
+    }
+    stages.append(qMakePair(QStringLiteral("main() entered"), processAgeUs));
+}
+
+void mark(const QString &stage)
+{
+    if (!timer.isValid())
+        return;
+
+    stages.append(qMakePair(stage, processAgeUs + timer.nsecsElapsed() / 1000));
+}
+
+QJsonArray report()
+{
+    QJsonArray result;
+    qint64 previousUs = 0;
+
+    for (const auto &stage : std::as_const(stages)) {
+        QJsonObject entry;
+        entry["stage"] = stage.first;
+        entry["atMs"] = stage.second / 1000.0;
+        entry["durationMs"] = (stage.second - previousUs) / 1000.0;
+        result.append(entry);
+        previousUs = stage.second;
+    }
+
+    return result;
+}
+
+} // namespace StartupTimer
@@ -0,0 +1,319 @@
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Tracer {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+namespace {
+
+constexpr int BufferCapacity = 1 << 14;     // Events kept per thread
+constexpr int HeartbeatMs = 20;
+constexpr int PollMs = 10;
+
+// Fields are atomic so dump() can read a slot its thread is overwriting,
+// relaxed accesses compile to plain moves
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<qint64> startNs{0};
+    std::atomic<qint64> durationNs{0};
+};
+
+struct ThreadBuffer {
+    int threadId = 0;
+    QString threadName;
+    std::atomic<quint64> written{0};
+    std::atomic<const char*> activeSpan{nullptr};
+    std::array<Event, BufferCapacity> events;
+};
+
+struct Stall {
+    qint64 startNs;
+    qint64 durationNs;
+    const char *span;
+};
+
+QElapsedTimer &clock()
+{
+    static QElapsedTimer timer = [] {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer;
+}
+
+// Buffers are kept until exit so spans of finished threads can still be dumped
+QMutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+thread_local ThreadBuffer *currentBuffer = nullptr;
+
+QMutex stallMutex;
+QList<Stall> stalls;
+std::atomic<int> stallThresholdMs{100};
+
+ThreadBuffer *threadBuffer()
+{
+    if (currentBuffer)
+        return currentBuffer;
+
+    auto buffer = std::make_unique<ThreadBuffer>();
+    QThread *thread = QThread::currentThread();
+    const bool isMain = QCoreApplication::instance()
+                        && thread == QCoreApplication::instance()->thread();
+    buffer->threadName = isMain ? QStringLiteral("Main") : thread->objectName();
+
+    QMutexLocker locker(&registryMutex);
+    buffer->threadId = int(registry.size()) + 1;
+    if (buffer->threadName.isEmpty())
+        buffer->threadName = QString("Thread %1").arg(buffer->threadId);
+    currentBuffer = buffer.get();
+    registry.push_back(std::move(buffer));
+    return currentBuffer;
+}
+
+void push(ThreadBuffer *buffer, const char *name, qint64 startNs, qint64 durationNs)
+{
+    // Single writer per buffer, publish the slot after filling it. The fence
+    // pairs with the one in dump(): a reader that sees any field of this event
+    // also sees written >= index and knows the slot was being replaced.
+    const quint64 index = buffer->written.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Event &event = buffer->events[index & (BufferCapacity - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.startNs.store(startNs, std::memory_order_relaxed);
+    event.durationNs.store(durationNs, std::memory_order_relaxed);
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+// Heartbeat timer on the main thread plus a watcher thread that notices
+// when the heartbeat stops and remembers the span the main thread was in
+class Watchdog
+{
+public:
+    void start()
+    {
+        if (m_thread)
+            return;
+
+        m_mainBuffer = threadBuffer();
+        m_heartbeatNs.store(now(), std::memory_order_relaxed);
+        m_running.store(true, std::memory_order_relaxed);
+
+        m_timer = new QTimer;
+        m_timer->setTimerType(Qt::PreciseTimer);
+        m_timer->setInterval(HeartbeatMs);
+        QObject::connect(m_timer, &QTimer::timeout, [this]() {
+            m_heartbeatNs.store(now(), std::memory_order_relaxed);
+        });
+        m_timer->start();
+
+        m_thread = QThread::create([this]() { watch(); });
+        m_thread->setObjectName("Watchdog");
+        m_thread->start();
+    }
+
+    void stop()
+    {
+        if (!m_thread)
+            return;
+
+        m_running.store(false, std::memory_order_relaxed);
+        m_thread->wait();
+        delete m_thread;
+        m_thread = nullptr;
+        delete m_timer;
+        m_timer = nullptr;
+    }
+
+private:
+    void watch()
+    {
+        bool inStall = false;
+        qint64 stallStartNs = 0;
+        qint64 lastBeatNs = m_heartbeatNs.load(std::memory_order_relaxed);
+        const char *span = nullptr;
+
+        while (m_running.load(std::memory_order_relaxed)) {
+            QThread::msleep(PollMs);
+
+            const qint64 beatNs = m_heartbeatNs.load(std::memory_order_relaxed);
+            const qint64 expectedNs = lastBeatNs + HeartbeatMs * 1000000LL;
+            const qint64 thresholdNs = stallThresholdMs.load(std::memory_order_relaxed) * 1000000LL;
+
+            if (beatNs != lastBeatNs) {
+                if (inStall) {
+                    QMutexLocker locker(&stallMutex);
+                    stalls.append({ stallStartNs, beatNs - stallStartNs, span });
+                    inStall = false;
+                }
+                lastBeatNs = beatNs;
+                span = nullptr;
+            } else if (now() - expectedNs > thresholdNs) {
+                if (!inStall) {
+                    inStall = true;
+                    stallStartNs = expectedNs;
+                }
+                // Keep sampling until the blocking span is known
+                if (!span)
+                    span = m_mainBuffer->activeSpan.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ThreadBuffer *m_mainBuffer = nullptr;
+    QThread *m_thread = nullptr;
+    QTimer *m_timer = nullptr;
+    std::atomic<qint64> m_heartbeatNs{0};
+    std::atomic<bool> m_running{false};
+};
+
+Watchdog watchdog;
+
+} // namespace
+
+void setEnabled(bool enable)
+{
+    detail::enabled.store(enable, std::memory_order_relaxed);
+
+    if (enable) {
+        watchdog.start();
+    } else {
+        watchdog.stop();
+    }
+}
+
+void setStallThreshold(int milliseconds)
+{
+    stallThresholdMs.store(qMax(1, milliseconds), std::memory_order_relaxed);
+}
+
+qint64 now()
+{
+    return clock().nsecsElapsed();
+}
+
+void addSpan(const char *name, qint64 startNs, qint64 endNs)
+{
+    if (!isEnabled() || startNs <= 0)
+        return;
+
+    push(threadBuffer(), name, startNs, endNs - startNs);
+}
+
+void Span::begin(const char *name)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    m_name = name;
+    m_parent = buffer->activeSpan.exchange(name, std::memory_order_relaxed);
+    m_startNs = now();
+}
+
+void Span::end()
+{
+    ThreadBuffer *buffer = currentBuffer;
+    buffer->activeSpan.store(m_parent, std::memory_order_relaxed);
+    push(buffer, m_name, m_startNs, now() - m_startNs);
+}
+
+bool dump(const QString &filePath)
+{
+    QJsonArray traceEvents;
+
+    auto threadNameEvent = [](int tid, const QString &name) {
+        QJsonObject event;
+        event["name"] = "thread_name";
+        event["ph"] = "M";
+        event["pid"] = 1;
+        event["tid"] = tid;
+        event["args"] = QJsonObject{ { "name", name } };
+        return event;
+    };
+
+    struct Copy {
+        const char *name;
+        qint64 startNs;
+        qint64 durationNs;
+    };
+
+    {
+        QMutexLocker locker(&registryMutex);
+        for (const auto &buffer : registry) {
+            traceEvents.append(threadNameEvent(buffer->threadId, buffer->threadName));
+
+            // Copy the ring first, events older than its capacity are gone
+            const quint64 written = buffer->written.load(std::memory_order_acquire);
+            const quint64 first = written > BufferCapacity ? written - BufferCapacity : 0;
+            std::vector<Copy> copies;
+            copies.reserve(written - first);
+            for (quint64 i = first; i < written; ++i) {
+                const Event &e = buffer->events[i & (BufferCapacity - 1)];
+                copies.push_back({ e.name.load(std::memory_order_relaxed),
+                                   e.startNs.load(std::memory_order_relaxed),
+                                   e.durationNs.load(std::memory_order_relaxed) });
+            }
+
+            // A thread still tracing may have started replacing the oldest
+            // slots while they were copied, drop those instead of mixing events
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const quint64 latest = buffer->written.load(std::memory_order_relaxed);
+            const quint64 valid = latest >= BufferCapacity ? latest - BufferCapacity + 1 : 0;
+
+            for (quint64 i = qMax(first, valid); i < written; ++i) {
+                const Copy &e = copies[i - first];
+                QJsonObject event;
+                event["name"] = QString::fromLatin1(e.name);
+                event["ph"] = "X";
+                event["pid"] = 1;
+                event["tid"] = buffer->threadId;
+                event["ts"] = e.startNs / 1000.0;
+                event["dur"] = e.durationNs / 1000.0;
+                traceEvents.append(event);
+            }
+        }
+    }
+
+    {
+        QMutexLocker locker(&stallMutex);
+        constexpr int StallTid = 0;
+        traceEvents.append(threadNameEvent(StallTid, "Event loop stalls"));
+        for (const Stall &stall : std::as_const(stalls)) {
+            QJsonObject event;
+            event["name"] = "Stall";
+            event["ph"] = "X";
+            event["pid"] = 1;
+            event["tid"] = StallTid;
+            event["ts"] = stall.startNs / 1000.0;
+            event["dur"] = stall.durationNs / 1000.0;
+            event["args"] = QJsonObject{
+                { "activeSpan", stall.span ? QString::fromLatin1(stall.span) : QString("(untraced)") }
+            };
+            traceEvents.append(event);
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) != -1;
+}
+
+} // namespace Tracer
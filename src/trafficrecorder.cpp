@@ -0,0 +1,173 @@
+#include "trafficrecorder.h"
+#include <QtEndian>
+
+namespace {
+const QByteArray TraceMagic("APTR");
+
+template <typename T>
+void appendLittleEndian(QByteArray &buffer, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, sizeof(T));
+}
+
+template <typename T>
+bool takeLittleEndian(const QByteArray &data, qsizetype &offset, T &value)
+{
+    if (offset + qsizetype(sizeof(T)) > data.size())
+        return false;
+    value = qFromLittleEndian<T>(data.constData() + offset);
+    offset += sizeof(T);
+    return true;
+}
+}
+
+TrafficRecorder::TrafficRecorder(QObject *parent)
+    : QObject(parent)
+{
+}
+
+bool TrafficRecorder::start(const QString &filePath)
+{
+    stop();
+
+    // Unbuffered so a crash or kill loses at most the record being written
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered))
+        return false;
+
+    QByteArray header = TraceMagic;
+    appendLittleEndian<quint16>(header, FormatVersion);
+    m_file.write(header);
+
+    m_connectionIds.clear();
+    ++m_session;
+    m_nextRecord = 0;
+    m_clock.start();
+    return true;
+}
+
+void TrafficRecorder::stop()
+{
+    if (m_file.isOpen())
+        m_file.close();
+}
+
+quint64 TrafficRecorder::record(TraceRecord::Kind kind, const QObject *connection, const QByteArray &payload)
+{
+    if (!m_file.isOpen())
+        return 0;
+
+    quint32 &connectionId = m_connectionIds[connection];
+    if (connectionId == 0)
+        connectionId = m_nextConnectionId++;
+
+    const quint64 token = (quint64(m_session) << 32) | (m_nextRecord + 1);
+    write(kind, connectionId, payload);
+
+    if (kind == TraceRecord::Disconnected)
+        m_connectionIds.remove(connection);
+
+    return token;
+}
+
+void TrafficRecorder::recordCompletion(quint64 request, bool success)
+{
+    // Presses recorded by an earlier session cannot be referred to
+    if (!m_file.isOpen() || request == 0 || quint32(request >> 32) != m_session)
+        return;
+
+    QByteArray payload;
+    appendLittleEndian<quint32>(payload, quint32(request) - 1);
+    appendLittleEndian<quint8>(payload, success ? 1 : 0);
+    write(TraceRecord::Completed, 0, payload);
+}
+
+void TrafficRecorder::write(TraceRecord::Kind kind, quint32 connectionId, const QByteArray &payload)
+{
+    ++m_nextRecord;
+
+    QByteArray buffer;
+    buffer.reserve(21 + payload.size());
+    appendLittleEndian<quint8>(buffer, kind);
+    appendLittleEndian<quint32>(buffer, connectionId);
+    appendLittleEndian<qint64>(buffer, m_clock.nsecsElapsed() / 1000);
+    appendLittleEndian<quint32>(buffer, quint32(payload.size()));
+    buffer.append(payload);
+
+    // One write per record, it reaches the file before record() returns
+    m_file.write(buffer);
+}
+
+bool TrafficRecorder::readTrace(const QString &filePath, QList<TraceRecord> &records)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray data = file.readAll();
+    qsizetype offset = 0;
+
+    // Later sessions are shifted to follow earlier ones and get their own
+    // connection id range, so a multi-session file replays as one timeline
+    qint64 sessionOffsetUs = 0;
+    qint64 lastTimestampUs = 0;
+    quint32 sessionIdBase = 0;
+    quint32 maxConnectionId = 0;
+    qsizetype sessionRecordBase = 0;
+
+    while (offset < data.size()) {
+        if (data.mid(offset, TraceMagic.size()) == TraceMagic) {
+            offset += TraceMagic.size();
+            quint16 version;
+            // Version 1 only lacks Completed records
+            if (!takeLittleEndian(data, offset, version) || version < 1 || version > FormatVersion)
+                return false;
+            sessionOffsetUs = lastTimestampUs;
+            sessionIdBase = maxConnectionId;
+            sessionRecordBase = records.size();
+            continue;
+        }
+
+        quint8 kind;
+        quint32 connectionId;
+        qint64 timestampUs;
+        quint32 length;
+        if (!takeLittleEndian(data, offset, kind)
+            || !takeLittleEndian(data, offset, connectionId)
+            || !takeLittleEndian(data, offset, timestampUs)
+            || !takeLittleEndian(data, offset, length)
+            || kind > TraceRecord::Completed
+            || offset + qsizetype(length) > data.size()) {
+            // A truncated tail is expected if the server was killed mid-write
+            break;
+        }
+
+        TraceRecord record;
+        record.kind = static_cast<TraceRecord::Kind>(kind);
+        record.connectionId = sessionIdBase + connectionId;
+        record.timestampUs = sessionOffsetUs + timestampUs;
+        record.payload = data.mid(offset, length);
+        offset += length;
+
+        if (record.kind == TraceRecord::Completed) {
+            record.connectionId = 0;
+            qsizetype payloadOffset = 0;
+            quint32 request;
+            quint8 success;
+            // Kept even when malformed, later records are found by position
+            if (takeLittleEndian(record.payload, payloadOffset, request)
+                && takeLittleEndian(record.payload, payloadOffset, success)) {
+                record.request = sessionRecordBase + request;
+                record.success = success != 0;
+            }
+        }
+
+        lastTimestampUs = record.timestampUs;
+        maxConnectionId = qMax(maxConnectionId, record.connectionId);
+        records.append(record);
+    }
+
+    return true;
+}
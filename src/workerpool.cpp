@@ -0,0 +1,348 @@
+#include "workerpool.h"
+#include "tracer.h"
+#include <QDeadlineTimer>
+
+namespace {
+constexpr int InitialBackoffMs = 500;
+constexpr int MaxBackoffMs = 30000;
+constexpr int MaxFailures = 5;
+constexpr int HealthIntervalMs = 5000;
+constexpr qint64 PingTimeoutNs = 2000LL * 1000000;
+constexpr qint64 RequestTimeoutNs = 30000LL * 1000000;
+}
+
+WorkerPool::WorkerPool(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    m_healthTimer.setInterval(HealthIntervalMs);
+    connect(&m_healthTimer, &QTimer::timeout, this, &WorkerPool::checkHealth);
+}
+
+WorkerPool::~WorkerPool()
+{
+    shutdown();
+}
+
+// Returns the request id later passed to requestFinished, or 0 when the
+// worker for this command line has been given up on
+quint64 WorkerPool::submit(int actionId, const QString &program, const QString &arguments)
+{
+    TRACE_SCOPE("workerSubmit");
+    Worker *worker = workerFor(program, arguments);
+
+    if (worker->failures >= MaxFailures) {
+        // Give a worker that was given up on one more try once the longest
+        // backoff has passed, a single failure gives it up again
+        if (m_clock.nsecsElapsed() - worker->exitedAtNs < MaxBackoffMs * 1000000LL) {
+            ++m_unavailable;
+            return 0;
+        }
+        worker->failures = MaxFailures - 1;
+    }
+
+    const quint64 requestId = m_nextRequestId++;
+    Request &request = worker->pending[requestId];
+    request.actionId = actionId;
+    request.sentAtNs = m_clock.nsecsElapsed();
+    request.written = worker->process && worker->started;
+    send(worker, QString("press %1 %2\n").arg(requestId).arg(actionId).toUtf8());
+
+    if (!worker->process)
+        scheduleStart(worker);
+
+    return requestId;
+}
+
+QString WorkerPool::commandLine(const QString &program, const QString &arguments)
+{
+    return program + '\n' + arguments;
+}
+
+void WorkerPool::retainOnly(const QSet<QString> &commandLines)
+{
+    for (auto it = m_workers.begin(); it != m_workers.end();) {
+        if (commandLines.contains(it.key())) {
+            ++it;
+        } else {
+            retire(it.value());
+            it = m_workers.erase(it);
+        }
+    }
+
+    if (m_workers.isEmpty())
+        m_healthTimer.stop();
+}
+
+WorkerPool::Worker *WorkerPool::workerFor(const QString &program, const QString &arguments)
+{
+    // Actions running the same command line share one worker
+    const QString key = commandLine(program, arguments);
+    if (Worker *worker = m_workers.value(key))
+        return worker;
+
+    Worker *worker = new Worker;
+    worker->program = program;
+    worker->arguments = arguments.split(' ', Qt::SkipEmptyParts);
+    worker->backoffMs = InitialBackoffMs;
+    worker->restartTimer = new QTimer(this);
+    worker->restartTimer->setSingleShot(true);
+    connect(worker->restartTimer, &QTimer::timeout, this, [this, worker]() { startWorker(worker); });
+
+    m_workers.insert(key, worker);
+
+    if (!m_healthTimer.isActive())
+        m_healthTimer.start();
+
+    return worker;
+}
+
+void WorkerPool::startWorker(Worker *worker)
+{
+    if (m_shuttingDown || worker->process)
+        return;
+
+    if (worker->exitedAtNs)
+        ++m_restarts;
+
+    QProcess *process = new QProcess(this);
+    worker->process = process;
+    worker->started = false;
+    worker->pingSentAtNs = 0;
+
+    // Nobody reads stderr, do not let it accumulate in memory
+    process->setStandardErrorFile(QProcess::nullDevice());
+
+    connect(process, &QProcess::started, this, [this, worker]() {
+        worker->started = true;
+        for (const QByteArray &line : std::as_const(worker->queued)) {
+            worker->process->write(line);
+        }
+        worker->queued.clear();
+        for (Request &request : worker->pending) {
+            request.written = true;
+        }
+    });
+    connect(process, &QProcess::readyReadStandardOutput, this, [this, worker]() {
+        onWorkerOutput(worker);
+    });
+    connect(process, &QProcess::finished, this, [this, worker]() {
+        onWorkerFinished(worker);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, worker](QProcess::ProcessError error) {
+        // A program that cannot be started never emits finished
+        if (error == QProcess::FailedToStart)
+            onWorkerFinished(worker);
+    });
+
+    process->start(worker->program, worker->arguments);
+}
+
+void WorkerPool::scheduleStart(Worker *worker)
+{
+    if (worker->process || worker->restartTimer->isActive())
+        return;
+
+    // Keep the backoff when the previous process died only a moment ago
+    const qint64 waitMs = worker->exitedAtNs
+            ? worker->backoffMs - (m_clock.nsecsElapsed() - worker->exitedAtNs) / 1000000
+            : 0;
+    if (waitMs > 0) {
+        worker->restartTimer->start(static_cast<int>(waitMs));
+    } else {
+        startWorker(worker);
+    }
+}
+
+void WorkerPool::retire(Worker *worker)
+{
+    const auto lost = worker->pending;
+    worker->pending.clear();
+    for (auto it = lost.cbegin(); it != lost.cend(); ++it) {
+        emit requestFinished(it.key(), it->actionId, false, "Worker stopped");
+    }
+
+    // Ask the process to quit without blocking, kill it if it does not
+    if (QProcess *process = worker->process) {
+        process->disconnect(this);
+        if (process->state() == QProcess::NotRunning) {
+            process->deleteLater();
+        } else {
+            connect(process, &QProcess::finished, process, &QObject::deleteLater);
+            QTimer::singleShot(500, process, [process]() {
+                process->kill();
+            });
+            process->write("quit\n");
+            process->closeWriteChannel();
+        }
+    }
+
+    delete worker->restartTimer;
+    delete worker;
+}
+
+void WorkerPool::send(Worker *worker, const QByteArray &line)
+{
+    if (worker->process && worker->started) {
+        worker->process->write(line);
+    } else {
+        worker->queued.append(line);
+    }
+}
+
+void WorkerPool::onWorkerOutput(Worker *worker)
+{
+    QProcess *process = worker->process;
+    while (process->canReadLine()) {
+        const QString line = QString::fromUtf8(process->readLine()).trimmed();
+
+        if (line.startsWith("pong ")) {
+            if (line.mid(5).toULongLong() == worker->pingId) {
+                worker->pingSentAtNs = 0;
+                worker->failures = 0;
+            }
+            continue;
+        }
+
+        if (!line.startsWith("done "))
+            continue;
+
+        // done <requestId> <exitCode> [output]
+        const QStringList parts = line.split(' ');
+        if (parts.size() < 3)
+            continue;
+
+        const quint64 requestId = parts[1].toULongLong();
+        const auto it = worker->pending.constFind(requestId);
+        if (it == worker->pending.constEnd())
+            continue;
+
+        const Request request = it.value();
+        worker->pending.erase(it);
+        worker->backoffMs = InitialBackoffMs;
+        worker->failures = 0;
+
+        ++m_completed;
+        m_lastLatencyMs = (m_clock.nsecsElapsed() - request.sentAtNs) / 1e6;
+
+        const QString output = line.section(' ', 3);
+        emit requestFinished(requestId, request.actionId, parts[2] == "0", output);
+    }
+}
+
+void WorkerPool::onWorkerFinished(Worker *worker)
+{
+    if (!worker->process)
+        return;
+
+    worker->process->deleteLater();
+    worker->process = nullptr;
+    worker->started = false;
+
+    if (m_shuttingDown)
+        return;
+
+    worker->exitedAtNs = m_clock.nsecsElapsed();
+    ++worker->failures;
+
+    // Presses the dead process had already read are reported as failed,
+    // queued ones are kept for the next process unless the worker is given up on
+    const bool givenUp = worker->failures >= MaxFailures;
+    QList<QPair<quint64, int>> lost;
+    for (auto it = worker->pending.begin(); it != worker->pending.end();) {
+        if (it->written || givenUp) {
+            lost.append(qMakePair(it.key(), it->actionId));
+            it = worker->pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (givenUp)
+        worker->queued.clear();
+
+    for (const auto &request : std::as_const(lost)) {
+        emit requestFinished(request.first, request.second, false,
+                             givenUp ? "Worker unavailable" : "Worker exited");
+    }
+
+    // An idle worker stays down until the next press
+    if (!worker->pending.isEmpty())
+        worker->restartTimer->start(worker->backoffMs);
+    worker->backoffMs = qMin(worker->backoffMs * 2, MaxBackoffMs);
+}
+
+void WorkerPool::checkHealth()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+
+    for (Worker *worker : std::as_const(m_workers)) {
+        if (!worker->process || !worker->started)
+            continue;
+
+        bool stuck = false;
+        for (const Request &request : std::as_const(worker->pending)) {
+            if (now - request.sentAtNs > RequestTimeoutNs)
+                stuck = true;
+        }
+
+        // finished() follows the kill and fails the pending presses
+        if (stuck || (worker->pingSentAtNs && now - worker->pingSentAtNs > PingTimeoutNs)) {
+            worker->process->kill();
+        } else if (worker->pending.isEmpty() && !worker->pingSentAtNs) {
+            // Only idle workers are pinged, a busy one may not read stdin
+            worker->pingId = m_nextRequestId++;
+            worker->pingSentAtNs = now;
+            send(worker, QString("ping %1\n").arg(worker->pingId).toUtf8());
+        }
+    }
+}
+
+void WorkerPool::shutdown()
+{
+    if (m_shuttingDown)
+        return;
+
+    m_shuttingDown = true;
+    m_healthTimer.stop();
+
+    // Ask every worker to quit first so they all exit in parallel, then
+    // share one deadline instead of waiting on each in turn
+    for (Worker *worker : std::as_const(m_workers)) {
+        if (worker->process) {
+            worker->process->disconnect(this);
+            worker->process->write("quit\n");
+            worker->process->closeWriteChannel();
+        }
+    }
+
+    const QDeadlineTimer deadline(500);
+    for (Worker *worker : std::as_const(m_workers)) {
+        if (worker->process) {
+            if (!worker->process->waitForFinished(int(deadline.remainingTime())))
+                worker->process->kill();
+            delete worker->process;
+        }
+        delete worker->restartTimer;
+    }
+
+    qDeleteAll(m_workers);
+    m_workers.clear();
+}
+
+QVariantMap WorkerPool::metrics() const
+{
+    int running = 0;
+    for (const Worker *worker : m_workers) {
+        if (worker->process && worker->started)
+            ++running;
+    }
+
+    QVariantMap result;
+    result["workers"] = m_workers.size();
+    result["running"] = running;
+    result["completed"] = m_completed;
+    result["restarts"] = m_restarts;
+    result["unavailable"] = m_unavailable;
+    result["lastLatencyMs"] = m_lastLatencyMs;
+    return result;
+}
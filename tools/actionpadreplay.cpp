@@ -0,0 +1,287 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQueue>
+#include <QSet>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QTimer>
+#include <algorithm>
+#include <functional>
+#include "trafficrecorder.h"
+
+// Replays the inbound side of a trace recorded with --record-traffic against
+// a running server (ideally started with --stub-execution) and compares the
+// response latency of each request with the latency seen when recording.
+//
+// Every replayed action_press is tagged with its own requestId and paired
+// with the action_result carrying it. Its recorded latency comes from the
+// Completed record the server writes for every press, or for traces older
+// than that, from the recorded action_result of a tagged press.
+// Any other request's response is the first outbound frame on the same
+// connection before its next inbound frame, ignoring press results. Frames
+// sent on connect are skipped, but broadcasts triggered by other connections
+// can still skew that pairing.
+
+namespace {
+
+struct Expectation {
+    qint64 sentAtNs = 0;
+    qint64 recordedLatencyUs = -1;
+};
+
+struct Connection {
+    QTcpSocket *socket = nullptr;
+    int unsolicited = 0;        // Frames the server sends before any request
+    QQueue<Expectation> expected;
+    QHash<QString, Expectation> presses;    // Replay requestId -> press
+};
+
+struct Sample {
+    double recordedUs;          // Negative when the recording has no response
+    double replayedUs;
+    bool press;
+};
+
+QJsonObject parseFrame(const QByteArray &frame)
+{
+    return QJsonDocument::fromJson(frame).object();
+}
+
+bool isPressResult(const QJsonObject &message)
+{
+    const QString type = message["type"].toString();
+    return type == "action_result" || type == "relay_result";
+}
+
+double percentile(QList<double> values, double p)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    const qsizetype index = qMin(values.size() - 1, qsizetype(p * values.size()));
+    return values[index];
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("ActionPadReplay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays an ActionPadServer traffic trace.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("trace", "Trace file written with --record-traffic.");
+    QCommandLineOption hostOption("host", "Server <address>.", "address", "127.0.0.1");
+    QCommandLineOption portOption("port", "Server <port>.", "port", "8080");
+    QCommandLineOption speedOption("speed", "Replay speed <factor>, 0 sends as fast as possible.",
+                                   "factor", "1.0");
+    parser.addOptions({ hostOption, portOption, speedOption });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    QList<TraceRecord> records;
+    if (!TrafficRecorder::readTrace(parser.positionalArguments().first(), records)) {
+        out << "Unable to read trace " << parser.positionalArguments().first() << Qt::endl;
+        return 1;
+    }
+
+    const QString host = parser.value(hostOption);
+    const quint16 port = parser.value(portOption).toUShort();
+    const double speed = parser.value(speedOption).toDouble();
+
+    // Pair every recorded request with the latency of its recorded response
+    QHash<qsizetype, qint64> recordedLatency;
+    QSet<qsizetype> presses;
+    QHash<quint32, int> unsolicitedFrames;
+    {
+        QHash<quint32, qsizetype> lastInbound;
+        QHash<QPair<quint32, QString>, qsizetype> taggedPresses;
+        QSet<quint32> seenInbound;
+        for (qsizetype i = 0; i < records.size(); ++i) {
+            const TraceRecord &record = records[i];
+            if (record.kind == TraceRecord::Completed) {
+                if (presses.contains(record.request))
+                    recordedLatency.insert(record.request, record.timestampUs - records[record.request].timestampUs);
+            } else if (record.kind == TraceRecord::Inbound) {
+                seenInbound.insert(record.connectionId);
+                const QJsonObject message = parseFrame(record.payload);
+                if (message["type"].toString() == "action_press") {
+                    presses.insert(i);
+                    if (message.contains("requestId")) {
+                        const QString requestId = message["requestId"].toVariant().toString();
+                        taggedPresses.insert(qMakePair(record.connectionId, requestId), i);
+                    }
+                } else {
+                    lastInbound[record.connectionId] = i;
+                }
+            } else if (record.kind == TraceRecord::Outbound) {
+                if (!seenInbound.contains(record.connectionId))
+                    ++unsolicitedFrames[record.connectionId];
+
+                const QJsonObject message = parseFrame(record.payload);
+                if (message["type"].toString() == "action_result") {
+                    const QString requestId = message["requestId"].toVariant().toString();
+                    const auto press = taggedPresses.constFind(qMakePair(record.connectionId, requestId));
+                    if (press != taggedPresses.constEnd()) {
+                        if (!recordedLatency.contains(press.value()))
+                            recordedLatency.insert(press.value(), record.timestampUs - records[press.value()].timestampUs);
+                        taggedPresses.erase(press);
+                    }
+                    continue;
+                }
+                if (isPressResult(message))
+                    continue;
+
+                const qsizetype request = lastInbound.value(record.connectionId, -1);
+                if (request >= 0) {
+                    recordedLatency.insert(request, record.timestampUs - records[request].timestampUs);
+                    lastInbound.remove(record.connectionId);
+                }
+            }
+        }
+    }
+
+    QHash<quint32, Connection> connections;
+    QList<Sample> samples;
+    QElapsedTimer clock;
+    qsizetype next = 0;
+    qsizetype sent = 0;
+
+    auto connectionFor = [&](quint32 connectionId) -> Connection & {
+        Connection &connection = connections[connectionId];
+        if (!connection.socket) {
+            connection.unsolicited = unsolicitedFrames.value(connectionId);
+            connection.socket = new QTcpSocket(&app);
+            connection.socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            connection.socket->connectToHost(host, port);
+            QObject::connect(connection.socket, &QTcpSocket::readyRead, &app, [&, connectionId]() {
+                Connection &c = connections[connectionId];
+                while (c.socket->canReadLine()) {
+                    const QJsonObject message = parseFrame(c.socket->readLine());
+                    const qint64 now = clock.nsecsElapsed();
+
+                    if (message["type"].toString() == "action_result") {
+                        const QString requestId = message["requestId"].toString();
+                        if (c.presses.contains(requestId)) {
+                            const Expectation expectation = c.presses.take(requestId);
+                            samples.append({ double(expectation.recordedLatencyUs),
+                                             (now - expectation.sentAtNs) / 1000.0, true });
+                        }
+                        continue;
+                    }
+                    if (isPressResult(message))
+                        continue;
+
+                    if (c.unsolicited > 0) {
+                        --c.unsolicited;
+                        continue;
+                    }
+                    if (c.expected.isEmpty())
+                        continue;
+                    const Expectation expectation = c.expected.dequeue();
+                    samples.append({ double(expectation.recordedLatencyUs),
+                                     (now - expectation.sentAtNs) / 1000.0, false });
+                }
+            });
+        }
+        return connection;
+    };
+
+    auto report = [&]() {
+        QList<double> recorded;
+        QList<double> replayed;
+        QList<double> deltas;
+        int pressResults = 0;
+        for (const Sample &sample : std::as_const(samples)) {
+            replayed.append(sample.replayedUs);
+            if (sample.press)
+                ++pressResults;
+            // Presses from traces without Completed records may have nothing to compare against
+            if (sample.recordedUs >= 0) {
+                recorded.append(sample.recordedUs);
+                deltas.append(sample.replayedUs - sample.recordedUs);
+            }
+        }
+
+        qsizetype unanswered = 0;
+        for (const Connection &connection : std::as_const(connections)) {
+            unanswered += connection.presses.size();
+        }
+
+        out << "Frames sent: " << sent << ", responses matched: " << samples.size()
+            << " (" << pressResults << " press results, " << unanswered << " presses unanswered)" << Qt::endl;
+        out << Qt::fixed;
+        out.setRealNumberPrecision(1);
+        out << "              p50 (us)    p95 (us)    max (us)" << Qt::endl;
+        auto row = [&](const char *label, const QList<double> &values) {
+            out << label
+                << qSetFieldWidth(12) << percentile(values, 0.50)
+                << percentile(values, 0.95)
+                << percentile(values, 1.0) << qSetFieldWidth(0) << Qt::endl;
+        };
+        row("recorded  ", recorded);
+        row("replayed  ", replayed);
+        row("delta     ", deltas);
+    };
+
+    // Steps through the trace, sleeping until each record is due
+    std::function<void()> step = [&]() {
+        const qint64 originUs = records.isEmpty() ? 0 : records.first().timestampUs;
+
+        while (next < records.size()) {
+            const TraceRecord &record = records[next];
+            if (speed > 0) {
+                const qint64 dueNs = qint64((record.timestampUs - originUs) * 1000 / speed);
+                const qint64 waitMs = (dueNs - clock.nsecsElapsed()) / 1000000;
+                if (waitMs > 0) {
+                    QTimer::singleShot(waitMs, Qt::PreciseTimer, &app, step);
+                    return;
+                }
+            }
+
+            if (record.kind == TraceRecord::Connected) {
+                connectionFor(record.connectionId);
+            } else if (record.kind == TraceRecord::Disconnected) {
+                if (connections.contains(record.connectionId))
+                    connections[record.connectionId].socket->disconnectFromHost();
+            } else if (record.kind == TraceRecord::Inbound) {
+                // Connections opened before recording started have no connect record
+                Connection &connection = connectionFor(record.connectionId);
+                const Expectation expectation{ clock.nsecsElapsed(), recordedLatency.value(next, -1) };
+                if (presses.contains(next)) {
+                    // Tag the press so its action_result can be told apart
+                    QJsonObject message = parseFrame(record.payload);
+                    const QString requestId = QString("replay-%1").arg(next);
+                    message["requestId"] = requestId;
+                    connection.presses.insert(requestId, expectation);
+                    connection.socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+                } else {
+                    if (recordedLatency.contains(next))
+                        connection.expected.enqueue(expectation);
+                    connection.socket->write(record.payload);
+                }
+                ++sent;
+            }
+            ++next;
+        }
+
+        // Leave time for the last responses to arrive
+        QTimer::singleShot(2000, &app, [&]() {
+            report();
+            app.quit();
+        });
+    };
+
+    clock.start();
+    QTimer::singleShot(0, &app, step);
+    return app.exec();
+}